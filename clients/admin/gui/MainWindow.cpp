@@ -26,8 +26,11 @@ MainWindow::~MainWindow()
 
 void MainWindow::serverConnected()
 {
+	const QVector<Common::Record> competitions = conn()->snapshot().take(Common::Table::Competition);
 	m_competition = new RecordObject(
-				waitFor(conn()->read(Common::Table::Competition, competitionId()), tr("Loading competition"), this),
+				competitions.isEmpty()
+				? waitFor(conn()->read(Common::Table::Competition, competitionId()), tr("Loading competition"), this)
+				: competitions.first(),
 				conn());
 	ui->competitionTab->setup(conn(), m_competition);
 	ui->coursesTab->setup(conn(), m_competition);
@@ -35,6 +38,11 @@ void MainWindow::serverConnected()
 void MainWindow::serverDisconnected()
 {
 }
+QVector<Common::Table> MainWindow::bootstrapTables() const
+{
+	// the tables the tabs set up in serverConnected() load
+	return {Common::Table::Stage, Common::Table::Course};
+}
 
 }
 }
@@ -27,6 +27,7 @@ private:
 	
 	void serverConnected() override;
 	void serverDisconnected() override;
+	QVector<Common::Table> bootstrapTables() const override;
 };
 
 }
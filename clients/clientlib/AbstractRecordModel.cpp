@@ -4,6 +4,8 @@
 #include <commonlib/ChangeQuery.h>
 #include <commonlib/ChangeResponse.h>
 
+#include <algorithm>
+
 namespace Sportsed {
 namespace Client {
 
@@ -140,37 +142,131 @@ void AbstractRecordModel::reload()
 		return;
 	}
 
+	const Common::Revision snapshotRevision = m_conn->snapshot().revision();
+	const std::optional<QVector<Common::Record>> snapshot = m_conn->snapshot().take(Common::TableQuery(m_table, m_target));
+	if (snapshot) {
+		load(*snapshot, snapshotRevision);
+		return;
+	}
+
 	m_loading = true;
 	emit loadingChanged(m_loading);
 
-	m_conn->find(Common::TableQuery(m_table, m_target)).then([this](const QVector<Common::Record> &records) {
+	// changes are picked up again once all records have been received
+	unsubscribe();
+	const int generation = ++m_reloadGeneration;
+
+	// rows that are still current, for example after reconnecting, are kept instead of being downloaded again
+	if (!m_dirty) {
+		m_conn->findIfModified(Common::TableQuery(m_table, m_target), m_revision).then([this, generation](const Common::ConditionalResult &result) {
+			if (generation != m_reloadGeneration) {
+				return;
+			}
+			if (result.isModified()) {
+				load(result.records(), result.revision());
+			} else {
+				m_loading = false;
+				emit loadingChanged(m_loading);
+				subscribe(result.revision());
+			}
+		}, [this, generation]() {
+			if (generation == m_reloadGeneration) {
+				m_loading = false;
+				emit loadingChanged(m_loading);
+			}
+		});
+		return;
+	}
+
+	m_dirty = true;
+	beginResetModel();
+	m_rows.clear();
+	endResetModel();
+
+	// rows are inserted as they arrive so that large tables become usable before they have been loaded completely
+	m_stream = m_conn->findStreamed(Common::TableQuery(m_table, m_target));
+	connect(m_stream, &RecordStream::records, this, [this](const QVector<Common::Record> &records) {
+		if (records.isEmpty()) {
+			return;
+		}
+		beginInsertRows(QModelIndex(), m_rows.size(), m_rows.size() + records.size() - 1);
+		m_rows += records;
+		endInsertRows();
+	});
+	connect(m_stream, &RecordStream::finished, this, [this](const Common::Revision revision) {
+		m_stream->deleteLater();
+		m_stream = nullptr;
 		m_loading = false;
 		emit loadingChanged(m_loading);
-		beginResetModel();
-		m_rows = records;
-		endResetModel();
-
-		const Common::Revision latest = m_rows.isEmpty() ? 0
-														 : std::max_element(m_rows.cbegin(), m_rows.cend(),
-																			[](const Common::Record &a, const Common::Record &b) {
-			return a.latestRevision() < b.latestRevision();
-		})->latestRevision();
-
-		if (m_subscription) {
-			delete m_subscription;
-		}
-		m_subscription = m_conn->subscribe(Common::ChangeQuery(Common::TableQuery(m_table, m_target), latest));
-		connect(m_subscription, &Subscribtion::triggered, this, &AbstractRecordModel::subscriptionsTriggered);
-	}, [this]() {
+		subscribe(revision);
+	});
+	connect(m_stream, &RecordStream::failed, this, [this]() {
+		m_stream->deleteLater();
+		m_stream = nullptr;
 		m_loading = false;
 		emit loadingChanged(m_loading);
 	});
 }
 
+void AbstractRecordModel::load(const QVector<Common::Record> &records, const Common::Revision revision)
+{
+	unsubscribe();
+	++m_reloadGeneration;
+	if (m_loading) {
+		m_loading = false;
+		emit loadingChanged(m_loading);
+	}
+
+	beginResetModel();
+	m_rows = records;
+	endResetModel();
+
+	subscribe(revision);
+}
+
+void AbstractRecordModel::unsubscribe()
+{
+	// we may be inside a signal of the subscription or stream (a resync triggers a reload), so they may only be deleted
+	// once control has returned to the event loop, and must not reach us anymore until then
+	if (m_subscription) {
+		m_subscription->disconnect(this);
+		m_subscription->deleteLater();
+		m_subscription = nullptr;
+	}
+	if (m_stream) {
+		m_stream->disconnect(this);
+		m_stream->deleteLater();
+		m_stream = nullptr;
+	}
+}
+void AbstractRecordModel::subscribe(const Common::Revision revision)
+{
+	m_dirty = false;
+	m_revision = revision;
+	Common::ChangeQuery query(Common::TableQuery(m_table, m_target), revision);
+	query.setDelta(true);
+	// catching up only needs the net change to each record
+	query.setCompact(true);
+	m_subscription = m_conn->subscribe(query);
+	connect(m_subscription, &Subscribtion::triggered, this, &AbstractRecordModel::subscriptionsTriggered);
+}
+
 void AbstractRecordModel::subscriptionsTriggered(const Common::ChangeResponse &res)
 {
+	if (res.isResyncRequired()) {
+		// we have been offline for longer than the server keeps changes around, the snapshot is at least as old
+		m_conn->setSnapshot(Common::Snapshot());
+		reload();
+		return;
+	}
+
+	QVector<Common::Id> missing;
 	for (const Common::Change &change : res.changes()) {
-		if (change.type() == Common::Change::Create || change.type() == Common::Change::Update) {
+		if (change.isDelta()) {
+			if (!patch(change)) {
+				missing.append(change.record().id());
+			}
+		} else if (change.type() == Common::Change::Create || change.type() == Common::Change::Update) {
 			set(change.record());
 		} else if (change.type() == Common::Change::Delete) {
 			for (int i = 0; i < m_rows.size(); ++i) {
@@ -182,6 +278,25 @@ void AbstractRecordModel::subscriptionsTriggered(const Common::ChangeResponse &r
 			}
 		}
 	}
+
+	// the records have (for example) just started to match our target, so we need all of them
+	if (!missing.isEmpty()) {
+		m_conn->readMany(m_table, missing).then([this](const Common::RecordBatch &batch) {
+			for (const Common::Record &record : batch.records()) {
+				if (!record.isNull()) {
+					set(record);
+				}
+			}
+		});
+	}
+
+	// replies may be cut short, in which case only the changes that have actually been applied are known to be seen.
+	// compacted replies never are, and changes that cancelled out have no revision left in them
+	Common::Revision applied = res.changes().isEmpty() || res.query().isCompact() ? res.lastRevision() : 0;
+	for (const Common::Change &change : res.changes()) {
+		applied = std::max(applied, change.revision());
+	}
+	m_revision = std::max(m_revision, applied);
 }
 
 void AbstractRecordModel::set(const Common::Record &record)
@@ -201,6 +316,23 @@ void AbstractRecordModel::set(const Common::Record &record)
 	endInsertRows();
 }
 
+bool AbstractRecordModel::patch(const Common::Change &change)
+{
+	const Common::Record delta = change.record();
+	for (int i = 0; i < m_rows.size(); ++i) {
+		if (m_rows.at(i).id() == delta.id()) {
+			const QHash<QString, QVariant> values = delta.values();
+			for (auto it = values.cbegin(); it != values.cend(); ++it) {
+				m_rows[i].setValue(it.key(), it.value());
+			}
+			m_rows[i].setLatestRevision(delta.latestRevision());
+			emit dataChanged(index(i, 0), index(i, m_columns), roleForFields(change.updatedFields()));
+			return true;
+		}
+	}
+	return false;
+}
+
 void AbstractRecordModel::registerField(const int role, const QString &field, const QString &header)
 {
 	m_roleToField.insert(role, field);
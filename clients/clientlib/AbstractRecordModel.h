@@ -3,6 +3,7 @@
 #include <QAbstractListModel>
 #include <QPair>
 
+#include <commonlib/Change.h>
 #include <commonlib/Record.h>
 #include <commonlib/TableQuery.h>
 
@@ -44,7 +45,10 @@ public:
 public slots:
 	Future<Common::Record> add();
 	void remove(const QModelIndex &index);
+	/// Loads the records from the snapshot of the connection if it contains them, from the server otherwise
 	void reload();
+	/// Replaces all rows by the given records, which reflect all changes up to the revision
+	void load(const QVector<Common::Record> &records, const Common::Revision revision);
 
 signals:
 	void loadingChanged(const bool loading);
@@ -67,16 +71,27 @@ private:
 	ServerConnection *m_conn;
 
 	bool m_loading = false;
-	bool m_dirty = false;
+	/// Set if the rows do not reflect the target at m_revision, in which case they can not be reloaded conditionally
+	bool m_dirty = true;
+	Common::Revision m_revision = 0;
+	/// Incremented by every reload, replies to earlier ones are ignored
+	int m_reloadGeneration = 0;
 
 	Common::Record m_defaultRecord;
 	QVector<Common::TableFilter> m_target;
 
 	QVector<Common::Record> m_rows;
 	Subscribtion *m_subscription = nullptr;
+	RecordStream *m_stream = nullptr;
 
+	/// Picks up changes made after the revision
+	void subscribe(const Common::Revision revision);
+	/// Stops picking up changes and receiving streamed records
+	void unsubscribe();
 	/// Add or update the given record
 	void set(const Common::Record &record);
+	/// Apply the values of a delta change to the local copy of the record, false if there is no local copy
+	bool patch(const Common::Change &change);
 
 	QVector<QPair<QString, QString>> m_registeredColumns;
 	QHash<int, QString> m_roleToField;
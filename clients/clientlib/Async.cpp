@@ -26,6 +26,12 @@ QJsonValue FutureImpl::get()
 
 	const QJsonObject obj = *m_value;
 	if (Json::ensureString(obj, "cmd") == "error") {
+		if (obj.value("conflict").toBool()) {
+			throw ConflictException(Json::ensureString(obj, "data"));
+		}
+		if (obj.value("not_found").toBool()) {
+			throw NotFoundException(Json::ensureString(obj, "data"));
+		}
 		throw FutureResultException(Json::ensureString(obj, "data"));
 	}
 	return Json::ensureValue(obj, "data");
@@ -62,5 +68,11 @@ void FutureImpl::receivedMessage(const QJsonObject &obj)
 Subscribtion::Subscribtion(QObject *parent)
 	: QObject(parent) {}
 
+AggregateSubscription::AggregateSubscription(QObject *parent)
+	: QObject(parent) {}
+
+RecordStream::RecordStream(QObject *parent)
+	: QObject(parent) {}
+
 }
 }
@@ -3,17 +3,32 @@
 #include <jd-util/Json.h>
 #include <functional>
 
+#include <commonlib/Record.h>
+
 class QEventLoop;
 
 namespace Sportsed {
 namespace Common {
 class ChangeResponse;
+class AggregateResult;
 }
 
 namespace Client {
 class ServerConnection;
 
 DECLARE_EXCEPTION(FutureResult)
+/// An update or delete was refused because the record has changed after the expected revision
+class ConflictException : public FutureResultException
+{
+public:
+	explicit ConflictException(const QString &cause) : FutureResultException(cause) {}
+};
+/// The requested record does not exist (anymore)
+class NotFoundException : public FutureResultException
+{
+public:
+	explicit NotFoundException(const QString &cause) : FutureResultException(cause) {}
+};
 
 // TODO consider replacing by custom ref-counted implementation
 class FutureImpl : public std::enable_shared_from_this<FutureImpl>
@@ -53,27 +68,27 @@ public:
 	T get() const { return JD::Util::Json::ensureIsType<T>(m_impl->get()); }
 	bool hasValue() const { return m_impl->hasValue(); }
 
-	void then(const std::function<void(T)> &cb, const std::function<void(Exception)> &errorCb = {})
+	void then(const std::function<void(T)> &cb, const std::function<void(const Exception &)> &errorCb = {})
 	{
 		thenImpl(cb, errorCb);
 	}
 	void then(const std::function<void(T)> &cb, const std::function<void()> &errorCb)
 	{
-		thenImpl(cb, [errorCb](Exception) { if (errorCb) errorCb(); });
+		thenImpl(cb, [errorCb](const Exception &) { if (errorCb) errorCb(); });
 	}
-	void then(const std::function<void()> &cb, const std::function<void(Exception)> &errorCb = {})
+	void then(const std::function<void()> &cb, const std::function<void(const Exception &)> &errorCb = {})
 	{
 		thenImpl([cb](T){ if (cb) cb(); }, errorCb);
 	}
 	void then(const std::function<void()> &cb, const std::function<void()> &errorCb)
 	{
-		thenImpl([cb](T){ if (cb) cb(); }, [errorCb](Exception) { if (errorCb) errorCb(); });
+		thenImpl([cb](T){ if (cb) cb(); }, [errorCb](const Exception &) { if (errorCb) errorCb(); });
 	}
 
 private:
 	std::shared_ptr<FutureImpl> m_impl;
 
-	void thenImpl(const std::function<void(T)> &cb, const std::function<void(Exception)> &errorCb)
+	void thenImpl(const std::function<void(T)> &cb, const std::function<void(const Exception &)> &errorCb)
 	{
 		std::shared_ptr<FutureImpl> impl = m_impl;
 		m_impl->then([impl, cb, errorCb]() {
@@ -81,7 +96,8 @@ private:
 			bool threw = false;
 			try {
 				val = JD::Util::Json::ensureIsType<T>(impl->get());
-			} catch (Exception e) {
+			} catch (Exception &e) {
+				// by reference, so that callbacks can tell e.g. a ConflictException apart
 				threw = true;
 				if (errorCb) {
 					errorCb(e);
@@ -113,5 +129,30 @@ signals:
 	void triggered(const Common::ChangeResponse &changes);
 };
 
+/// Receives the recomputed result whenever a change alters the aggregates
+class AggregateSubscription : public QObject
+{
+	Q_OBJECT
+public:
+	explicit AggregateSubscription(QObject *parent = nullptr);
+
+signals:
+	void triggered(const Common::AggregateResult &result);
+};
+
+/// Result of a streamed find, records are emitted in chunks as they arrive
+class RecordStream : public QObject
+{
+	Q_OBJECT
+public:
+	explicit RecordStream(QObject *parent = nullptr);
+
+signals:
+	void records(const QVector<Common::Record> &records);
+	/// All records have been received, changes after the given revision are not included in them
+	void finished(const Common::Revision revision);
+	void failed();
+};
+
 }
 }
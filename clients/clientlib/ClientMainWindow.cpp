@@ -7,6 +7,7 @@
 #include <QProgressDialog>
 #include <QMessageBox>
 #include <QSettings>
+#include <QDebug>
 #include <clientlib/ServerConnection.h>
 #include <jd-util/Util.h>
 
@@ -46,7 +47,7 @@ ClientMainWindow::ClientMainWindow(const QString &profileType, QWidget *parent)
 			} else {
 				setCompetitionId(dlg.competitionId());
 			}
-			serverConnected();
+			setupConnected();
 		}
 		m_connectedActions->setEnabled(connected);
 		m_disconnectedActions->setEnabled(!connected);
@@ -106,6 +107,25 @@ void ClientMainWindow::registerActions(QAction *connectAct, QAction *disconnectA
 	m_disconnectedActions->addAction(connectAct);
 }
 
+QVector<Common::Table> ClientMainWindow::bootstrapTables() const
+{
+	return {};
+}
+
+void ClientMainWindow::setupConnected()
+{
+	try {
+		m_conn->setSnapshot(waitFor(m_conn->bootstrap(m_competitionId, bootstrapTables()),
+									tr("Loading competition..."), this));
+	} catch (Exception &e) {
+		// models load their records themselves without a snapshot
+		qWarning() << "unable to bootstrap:" << e.cause();
+	}
+	serverConnected();
+	// whatever the window has not taken by now would only be held until disconnecting
+	m_conn->setSnapshot(Common::Snapshot());
+}
+
 void ClientMainWindow::setCompetitionId(const Common::Id id)
 {
 	m_competitionId = id;
@@ -119,7 +139,7 @@ void ClientMainWindow::connectClicked()
 	ConnectionDialog dlg(m_conn, this);
 	if (dlg.exec() == ConnectionDialog::Accepted) {
 		m_competitionId = dlg.competitionId();
-		serverConnected();
+		setupConnected();
 	} else {
 		close();
 	}
@@ -40,6 +40,9 @@ protected:
 	void registerActions(QAction *connect, QAction *disconnectAct, QAction *loadProfileAct, QAction *storeProfileAct);
 	virtual void serverConnected() = 0;
 	virtual void serverDisconnected() = 0;
+	/// Tables whose records of the competition are fetched in one go before serverConnected() is called, which has to
+	/// load them from ServerConnection::snapshot(). None by default
+	virtual QVector<Common::Table> bootstrapTables() const;
 
 	void setCompetitionId(const Common::Id id);
 	Common::Id competitionId() const { return m_competitionId; }
@@ -52,6 +55,9 @@ private slots:
 	void storeProfileClicked();
 
 private:
+	/// Bootstraps and calls serverConnected()
+	void setupConnected();
+
 #ifdef SPORTSED_SKIP_AUTH
 	EmbeddedServerConnection *m_conn;
 #else
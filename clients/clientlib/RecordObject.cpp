@@ -1,5 +1,7 @@
 #include "RecordObject.h"
 
+#include <QTimer>
+
 #include <commonlib/ChangeQuery.h>
 #include <commonlib/ChangeResponse.h>
 
@@ -72,14 +74,50 @@ void RecordObject::delete_()
 
 void RecordObject::setupChangeSubscription(const Common::Revision &from)
 {
-	m_subscription = m_conn->subscribe(Common::ChangeQuery(
-										   Common::TableQuery(m_record.table(), Common::TableFilter("id", m_record.id())),
-										   from
-										   ));
+	Common::ChangeQuery query(Common::TableQuery(m_record.table(), Common::TableFilter("id", m_record.id())), from);
+	query.setDelta(true);
+	query.setCompact(true);
+	m_subscription = m_conn->subscribe(query);
 	connect(m_subscription, &Subscribtion::triggered, this, [this](const Common::ChangeResponse &res) {
+		if (res.isResyncRequired()) {
+			m_conn->readIfModified(m_record.table(), m_record.id(), m_record.latestRevision()).then([this](const Common::ConditionalResult &result) {
+				if (result.isModified()) {
+					const Common::Record rec = result.records().first();
+					const QVector<QString> changes = rec.changesBetween(m_record);
+					m_record = rec;
+					emit updated(changes);
+				}
+				delete m_subscription;
+				setupChangeSubscription(result.revision());
+			}, [this](const Exception &e) {
+				delete m_subscription;
+				m_subscription = nullptr;
+				if (dynamic_cast<const NotFoundException *>(&e)) {
+					// deleted while we were not looking
+					m_record.unsetId();
+					emit deleted();
+					return;
+				}
+				// anything else says nothing about the record, so keep it and try again in a bit
+				emit error(e.cause());
+				QTimer::singleShot(resyncRetryInterval, this, [this]() {
+					if (!m_subscription && m_record.isPersisted()) {
+						setupChangeSubscription(m_record.latestRevision());
+					}
+				});
+			});
+			return;
+		}
 		for (const Common::Change &change : res.changes()) {
 			if (change.type() == Common::Change::Create) {
 				// handled in RecordObject::create
+			} else if (change.type() == Common::Change::Update && change.isDelta()) {
+				const QHash<QString, QVariant> values = change.record().values();
+				for (auto it = values.cbegin(); it != values.cend(); ++it) {
+					m_record.setValue(it.key(), it.value());
+				}
+				m_record.setLatestRevision(change.record().latestRevision());
+				emit updated(change.updatedFields());
 			} else if (change.type() == Common::Change::Update) {
 				m_record = change.record();
 				emit updated(change.updatedFields());
@@ -35,6 +35,9 @@ signals:
 	void error(const QString &error);
 
 private:
+	/// Milliseconds to wait before retrying a resync that failed for other reasons than the record being gone
+	static constexpr int resyncRetryInterval = 5000;
+
 	Common::Record m_record;
 	ServerConnection *m_conn;
 	Subscribtion *m_subscription = nullptr;
@@ -2,10 +2,13 @@
 
 #include <jd-util/Json.h>
 #include <QEventLoop>
+#include <QJsonArray>
 #include <QLocalSocket>
+#include <QPointer>
 #include <QTimer>
 
 #include <commonlib/MessageSocket.h>
+#include <commonlib/AggregateQuery.h>
 #include <commonlib/ChangeQuery.h>
 #include <commonlib/ChangeResponse.h>
 #include <commonlib/Validators.h>
@@ -253,45 +256,147 @@ Future<Common::ChangeResponse> ServerConnection::changes(const Common::ChangeQue
 	return Future<Common::ChangeResponse>(sendMessage("changes", query.toJson()));
 }
 
+Future<QJsonObject> ServerConnection::revisions()
+{
+	return Future<QJsonObject>(sendMessage("revisions", QJsonValue()));
+}
+
 Future<Common::Record> ServerConnection::create(const Common::Record &record)
 {
 	Common::BaseValidator::getValidator(record.table())->validateRecord(record);
 	qCInfo(serverConnection) << "CREATE" << Common::tableName(record.table()) << record.values();
 	return Future<Common::Record>(sendMessage("create", record.toJson()));
 }
-Future<Common::Record> ServerConnection::read(const Common::Table &table, const Common::Id &id)
+Future<Common::Record> ServerConnection::read(const Common::Table &table, const Common::Id &id, const QVector<QString> &fields)
 {
 	qCInfo(serverConnection) << "READ" << Common::tableName(table) << id;
-	return Future<Common::Record>(sendMessage("read", QJsonObject({
-																	  {"table", Common::tableName(table)},
-																	  {"id", Json::toJson(id)}
-																  })));
+	QJsonObject obj({
+						{"table", Common::tableName(table)},
+						{"id", Json::toJson(id)}
+					});
+	if (!fields.isEmpty()) {
+		obj.insert("fields", Json::toJsonArray(fields));
+	}
+	return Future<Common::Record>(sendMessage("read", obj));
+}
+Future<Common::RecordBatch> ServerConnection::readMany(const Common::Table &table, const QVector<Common::Id> &ids)
+{
+	qCInfo(serverConnection) << "READ" << Common::tableName(table) << ids;
+	return Future<Common::RecordBatch>(sendMessage("read_many", QJsonObject({
+																				{"table", Common::tableName(table)},
+																				{"ids", Json::toJsonArray(ids)}
+																			})));
+}
+Future<Common::ConditionalResult> ServerConnection::readIfModified(const Common::Table &table, const Common::Id &id, const Common::Revision revision)
+{
+	qCInfo(serverConnection) << "READ" << Common::tableName(table) << id << "if modified after" << revision;
+	return Future<Common::ConditionalResult>(sendMessage("read", QJsonObject({
+																				 {"table", Common::tableName(table)},
+																				 {"id", Json::toJson(id)},
+																				 {"if_revision", Json::toJson(revision)}
+																			 })));
 }
-Future<Common::Revision> ServerConnection::update(const Common::Record &record)
+Future<Common::Revision> ServerConnection::update(const Common::Record &record, const std::optional<Common::Revision> &expectedRevision)
 {
-	for (auto it = record.values().cbegin(); it != record.values().cend(); ++it) {
-		Common::BaseValidator::getValidator(record.table())->validateField(it.key(), it.value());
+	for (const QString &field : record.fields()) {
+		Common::BaseValidator::getValidator(record.table())->validateField(field, record.value(field));
 	}
 	qCInfo(serverConnection) << "UPDATE" << Common::tableName(record.table()) << record.id() << record.values();
-	return Future<Common::Revision>(sendMessage("update", record.toJson()));
+	QJsonObject obj = record.toJson().toObject();
+	if (expectedRevision) {
+		obj.insert("expected_revision", Json::toJson(*expectedRevision));
+	}
+	return Future<Common::Revision>(sendMessage("update", obj));
 }
-Future<Common::Revision> ServerConnection::delete_(const Common::Table &table, const Common::Id &id)
+Future<Common::Revision> ServerConnection::delete_(const Common::Table &table, const Common::Id &id,
+												   const std::optional<Common::Revision> &expectedRevision)
 {
 	qCInfo(serverConnection) << "DELETE" << Common::tableName(table) << id;
-	return Future<Common::Revision>(sendMessage("delete", QJsonObject({
-																		  {"table", Common::tableName(table)},
-																		  {"id", Json::toJson(id)}
-																	  })));
+	QJsonObject obj({
+						{"table", Common::tableName(table)},
+						{"id", Json::toJson(id)}
+					});
+	if (expectedRevision) {
+		obj.insert("expected_revision", Json::toJson(*expectedRevision));
+	}
+	return Future<Common::Revision>(sendMessage("delete", obj));
 }
-Future<Common::Revision> ServerConnection::delete_(const Common::Record &record)
+Future<Common::Revision> ServerConnection::delete_(const Common::Record &record, const std::optional<Common::Revision> &expectedRevision)
 {
-	return delete_(record.table(), record.id());
+	return delete_(record.table(), record.id(), expectedRevision);
 }
 
 Future<QVector<Common::Record> > ServerConnection::find(const Common::TableQuery &query)
 {
 	qCInfo(serverConnection) << "FIND" << Common::tableName(query.table()) << query.filters();
-	return Future<QVector<Common::Record>>(sendMessage("find", query.toJson()));
+	Common::TableQuery plain = query;
+	plain.setIncludes({});
+	return Future<QVector<Common::Record>>(sendMessage("find", plain.toJson()));
+}
+Future<Common::ConditionalResult> ServerConnection::findIfModified(const Common::TableQuery &query, const Common::Revision revision)
+{
+	qCInfo(serverConnection) << "FIND" << Common::tableName(query.table()) << query.filters() << "if modified after" << revision;
+	Common::TableQuery plain = query;
+	plain.setIncludes({});
+	QJsonObject obj = plain.toJson();
+	obj.insert("if_revision", Json::toJson(revision));
+	return Future<Common::ConditionalResult>(sendMessage("find", obj));
+}
+Future<Common::FindResult> ServerConnection::findWithIncludes(const Common::TableQuery &query)
+{
+	qCInfo(serverConnection) << "FIND" << Common::tableName(query.table()) << query.filters() << "including" << query.includes();
+	QJsonObject obj = query.toJson();
+	obj.insert("include", Json::toJsonArray(query.includes()));
+	return Future<Common::FindResult>(sendMessage("find", obj));
+}
+
+RecordStream *ServerConnection::findStreamed(const Common::TableQuery &query, const int chunkSize)
+{
+	qCInfo(serverConnection) << "FIND(streamed)" << Common::tableName(query.table()) << query.filters();
+	RecordStream *stream = new RecordStream(this);
+	const std::shared_ptr<FutureImpl> impl = sendMessage("find_streamed", QJsonObject({
+																						 {"query", query.toJson()},
+																						 {"chunk_size", chunkSize}
+																					 }));
+	const int msgId = impl->m_msgId;
+	m_streams.insert(msgId, stream);
+
+	QPointer<RecordStream> guard(stream);
+	Future<QJsonObject>(impl).then([this, guard, msgId](const QJsonObject &obj) {
+		m_streams.remove(msgId);
+		if (guard) {
+			emit guard->finished(Json::ensureIsType<Common::Revision>(obj, "revision"));
+		}
+	}, [this, guard, msgId]() {
+		m_streams.remove(msgId);
+		if (guard) {
+			emit guard->failed();
+		}
+	});
+	connect(stream, &RecordStream::destroyed, this, [this, msgId]() {
+		m_streams.remove(msgId);
+	});
+
+	return stream;
+}
+
+Future<Common::Snapshot> ServerConnection::bootstrap(const Common::Id competitionId, const QVector<Common::Table> &tables)
+{
+	qCInfo(serverConnection) << "BOOTSTRAP" << competitionId;
+	QJsonArray tableNames;
+	for (const Common::Table table : tables) {
+		tableNames.append(Common::tableName(table));
+	}
+	return Future<Common::Snapshot>(sendMessage("bootstrap", QJsonObject({
+																			 {"competition_id", Json::toJson(competitionId)},
+																			 {"tables", tableNames}
+																		 })));
+}
+
+Future<Common::AggregateResult> ServerConnection::aggregate(const Common::AggregateQuery &query)
+{
+	qCInfo(serverConnection) << "AGGREGATE" << Common::tableName(query.query().table()) << query.query().filters();
+	return Future<Common::AggregateResult>(sendMessage("aggregate", query.toJson()));
 }
 
 Subscribtion *ServerConnection::subscribe(const Common::ChangeQuery &query)
@@ -329,11 +434,48 @@ Subscribtion *ServerConnection::subscribe(const Common::ChangeQuery &query)
 	return sub;
 }
 
+AggregateSubscription *ServerConnection::subscribeAggregate(const Common::AggregateQuery &query)
+{
+	AggregateSubscription *sub = new AggregateSubscription(this);
+	m_pendingAggregateSubscriptions.append(sub);
+	auto fut = Future<QJsonObject>(sendMessage("subscribe_aggregate", query.toJson()));
+	fut.then([this, sub, query](const QJsonObject &obj) {
+		const int subscriptionId = Json::ensureInteger(obj, "subscription");
+		qCInfo(serverConnection) << qPrintable(QStringLiteral("SUBSCRIBEd(%1)").arg(subscriptionId))
+								 << "AGGREGATE" << Common::tableName(query.query().table()) << query.query().filters();
+		if (m_pendingAggregateSubscriptions.contains(sub)) {
+			m_aggregateSubscriptions.insert(subscriptionId, sub);
+			m_pendingAggregateSubscriptions.removeAll(sub);
+			emit sub->triggered(Json::ensureIsType<Common::AggregateResult>(obj, "result"));
+		} else {
+			sendMessage("unsubscribe", subscriptionId);
+		}
+	});
+	connect(sub, &AggregateSubscription::destroyed, this, [this, sub]() {
+		if (m_pendingAggregateSubscriptions.contains(sub)) {
+			m_pendingAggregateSubscriptions.removeAll(sub);
+		} else {
+			const int id = m_aggregateSubscriptions.key(sub, -1);
+			if (id != -1) {
+				m_aggregateSubscriptions.remove(id);
+				qCInfo(serverConnection) << qPrintable(QStringLiteral("UNSUBSCRIBE(%1)").arg(id));
+				sendMessage("unsubscribe", id);
+			}
+		}
+	});
+
+	return sub;
+}
+
 void ServerConnection::recalculateConnected()
 {
 	const bool newValue = m_socket->state() == QTcpSocket::ConnectedState && m_authenticated;
 	if (newValue != m_isConnected) {
 		m_isConnected = newValue;
+		if (!m_isConnected) {
+			// changes made while disconnected would only be picked up through the change log of the server
+			m_snapshot = Common::Snapshot();
+		}
 		emit connectedChanged(newValue);
 	}
 }
@@ -360,9 +502,9 @@ void ServerConnection::received(const QByteArray &msg)
 
 					QStringList fields;
 					fields.append("id=" + QString::number(c.record().id()));
-					for (auto it = c.record().values().cbegin(); it != c.record().values().cend(); ++it) {
-						if (it.key().endsWith("id")) {
-							fields.append(it.key() + '=' + it.value().toString());
+					for (const QString &field : c.record().fields()) {
+						if (field.endsWith("id")) {
+							fields.append(field + '=' + c.record().value(field).toString());
 						}
 					}
 
@@ -370,6 +512,17 @@ void ServerConnection::received(const QByteArray &msg)
 				}).join(QStringLiteral(", ")));
 				emit m_subscriptions.value(subscribtion)->triggered(changes);
 			}
+		} else if (cmd == "aggregate") {
+			const int subscribtion = Json::ensureInteger(obj, "reply_to");
+			if (m_aggregateSubscriptions.contains(subscribtion)) {
+				qCInfo(serverConnection) << qPrintable(QStringLiteral("SUBDATA(%1)").arg(subscribtion)) << "AGGREGATE";
+				emit m_aggregateSubscriptions.value(subscribtion)->triggered(Json::ensureIsType<Common::AggregateResult>(obj, "data"));
+			}
+		} else if (cmd == "chunk") {
+			const int msgId = Json::ensureInteger(obj, "reply_to");
+			if (m_streams.contains(msgId)) {
+				emit m_streams.value(msgId)->records(Json::ensureIsArrayOf<Common::Record>(obj, "data"));
+			}
 		} else if (cmd == "reply" || cmd == "error") {
 			const int msgId = Json::ensureInteger(obj, "reply_to");
 			if (m_futures.contains(msgId)) {
@@ -8,6 +8,7 @@
 
 #include <commonlib/Record.h>
 #include <commonlib/TableQuery.h>
+#include <commonlib/Snapshot.h>
 
 #include "Async.h"
 
@@ -19,6 +20,8 @@ namespace Common {
 class MessageSocket;
 class ChangeQuery;
 class ChangeResponse;
+class AggregateQuery;
+class AggregateResult;
 }
 
 namespace Client {
@@ -42,6 +45,12 @@ public:
 
 	bool isConnected() const { return m_isConnected; }
 
+	/// Records fetched by bootstrap() that models use instead of loading them again, cleared when disconnected. Users
+	/// take their results out of it so that they are not kept around once they have been loaded
+	const Common::Snapshot &snapshot() const { return m_snapshot; }
+	Common::Snapshot &snapshot() { return m_snapshot; }
+	void setSnapshot(const Common::Snapshot &snapshot) { m_snapshot = snapshot; }
+
 signals:
 	void status(const QString &msg);
 	void connectedChanged(const bool connected);
@@ -50,14 +59,36 @@ signals:
 public slots:
 	Future<int> version();
 	Future<Common::ChangeResponse> changes(const Common::ChangeQuery &query);
+	/// Latest revision overall and per table, as {"latest": rev, "tables": {"<table>": rev, ...}}
+	Future<QJsonObject> revisions();
 	Future<Common::Record> create(const Common::Record &record);
-	Future<Common::Record> read(const Common::Table &table, const Common::Id &id);
-	Future<Common::Revision> update(const Common::Record &record);
-	Future<Common::Revision> delete_(const Common::Table &table, const Common::Id &id);
-	Future<Common::Revision> delete_(const Common::Record &record);
+	/// Reads the given record, only including the given fields if any are given
+	Future<Common::Record> read(const Common::Table &table, const Common::Id &id, const QVector<QString> &fields = {});
+	/// Reads all given records with a single request, see Common::RecordBatch
+	Future<Common::RecordBatch> readMany(const Common::Table &table, const QVector<Common::Id> &ids);
+	/// Only returns the record if it has changed after the given revision
+	Future<Common::ConditionalResult> readIfModified(const Common::Table &table, const Common::Id &id, const Common::Revision revision);
+	/// If an expected revision is given the update fails with a ConflictException if the record has changed since
+	Future<Common::Revision> update(const Common::Record &record, const std::optional<Common::Revision> &expectedRevision = {});
+	Future<Common::Revision> delete_(const Common::Table &table, const Common::Id &id,
+									 const std::optional<Common::Revision> &expectedRevision = {});
+	Future<Common::Revision> delete_(const Common::Record &record, const std::optional<Common::Revision> &expectedRevision = {});
+	/// Finds the records matching the query, includes are ignored
 	Future<QVector<Common::Record>> find(const Common::TableQuery &query);
+	/// Only returns the records if the result may have changed after the given revision, includes are ignored
+	Future<Common::ConditionalResult> findIfModified(const Common::TableQuery &query, const Common::Revision revision);
+	/// Finds the records matching the query together with the records referenced through its includes
+	Future<Common::FindResult> findWithIncludes(const Common::TableQuery &query);
+	/// Like find(), but the server sends the records in chunks of at most chunkSize records
+	RecordStream *findStreamed(const Common::TableQuery &query, const int chunkSize = 256);
+
+	/// The competition and its records of the given tables in a single reply
+	Future<Common::Snapshot> bootstrap(const Common::Id competitionId, const QVector<Common::Table> &tables);
+	Future<Common::AggregateResult> aggregate(const Common::AggregateQuery &query);
 
 	Subscribtion *subscribe(const Common::ChangeQuery &query);
+	/// Emits the current result once it has been computed and then whenever it changes
+	AggregateSubscription *subscribeAggregate(const Common::AggregateQuery &query);
 
 protected:
 	bool m_shouldBeConnected = false;
@@ -70,6 +101,8 @@ protected:
 	bool m_isConnected = false;
 	void recalculateConnected();
 
+	Common::Snapshot m_snapshot;
+
 	void received(const QByteArray &msg);
 
 	std::shared_ptr<FutureImpl> sendMessage(const QString &cmd, const QJsonValue &value);
@@ -81,6 +114,11 @@ protected:
 
 	QHash<int, Subscribtion *> m_subscriptions;
 	QVector<Subscribtion *> m_pendingSubscriptions;
+
+	QHash<int, AggregateSubscription *> m_aggregateSubscriptions;
+	QVector<AggregateSubscription *> m_pendingAggregateSubscriptions;
+
+	QHash<int, RecordStream *> m_streams;
 };
 class TcpServerConnection : public ServerConnection
 {
@@ -0,0 +1,166 @@
+#include "AggregateQuery.h"
+
+#include <jd-util/Json.h>
+
+#include <QJsonArray>
+
+#include "Validators.h"
+
+using namespace JD::Util;
+
+namespace Sportsed {
+namespace Common {
+
+Aggregate::Aggregate() {}
+
+Aggregate::Aggregate(const Aggregate::Function function, const QString &field)
+	: m_function(function), m_field(field) {}
+
+static const Json::Enum<Aggregate::Function> functionEnum = {
+	{Aggregate::Count, "count"},
+	{Aggregate::Sum, "sum"},
+	{Aggregate::Min, "min"},
+	{Aggregate::Max, "max"}
+};
+Aggregate Aggregate::fromJson(const QJsonObject &obj)
+{
+	Aggregate aggregate;
+	aggregate.m_function = functionEnum.ensure(obj, "function");
+	if (obj.contains("field")) {
+		aggregate.m_field = Json::ensureString(obj, "field");
+	}
+	return aggregate;
+}
+QJsonObject Aggregate::toJson() const
+{
+	QJsonObject obj({{"function", functionEnum.toJson(m_function)}});
+	if (!m_field.isEmpty()) {
+		obj.insert("field", m_field);
+	}
+	return obj;
+}
+
+bool Aggregate::operator==(const Aggregate &other) const
+{
+	return m_function == other.m_function && m_field == other.m_field;
+}
+
+AggregateQuery::AggregateQuery() {}
+
+AggregateQuery::AggregateQuery(const TableQuery &query, const QVector<Aggregate> &aggregates, const QVector<QString> &groupBy)
+	: m_query(query), m_aggregates(aggregates), m_groupBy(groupBy) {}
+
+AggregateQuery AggregateQuery::fromJson(const QJsonObject &obj)
+{
+	AggregateQuery query;
+	query.m_query = Json::ensureIsType<TableQuery>(obj, "query");
+	query.m_aggregates = Json::ensureIsArrayOf<Aggregate>(obj, "aggregates");
+	if (obj.contains("group_by")) {
+		query.m_groupBy = Json::ensureIsArrayOf<QString>(obj, "group_by");
+	}
+	return query;
+}
+QJsonObject AggregateQuery::toJson() const
+{
+	QJsonObject obj({
+						{"query", m_query.toJson()},
+						{"aggregates", Json::toJsonArray(m_aggregates)}
+					});
+	if (!m_groupBy.isEmpty()) {
+		obj.insert("group_by", Json::toJsonArray(m_groupBy));
+	}
+	return obj;
+}
+
+bool AggregateQuery::operator==(const AggregateQuery &other) const
+{
+	return m_query == other.m_query && m_aggregates == other.m_aggregates && m_groupBy == other.m_groupBy;
+}
+
+AggregateGroup::AggregateGroup(const QVector<QVariant> &key, const QVector<QVariant> &values)
+	: m_key(key), m_values(values) {}
+
+bool AggregateGroup::operator==(const AggregateGroup &other) const
+{
+	return m_key == other.m_key && m_values == other.m_values;
+}
+
+AggregateResult::AggregateResult() {}
+
+static QJsonArray variantsToJson(const QVector<QVariant> &values)
+{
+	QJsonArray array;
+	for (const QVariant &value : values) {
+		array.append(Json::toJson(value));
+	}
+	return array;
+}
+/// JSON loses types like dates, the values are converted back to the type of the field they originate from
+static QVariant coerce(BaseValidator *validator, const QString &field, const QVariant &value)
+{
+	if (!validator || field.isEmpty() || value.isNull()) {
+		return value;
+	}
+	try {
+		return validator->coerce(field, value);
+	} catch (CoercionException &) {
+		return value;
+	}
+}
+
+AggregateResult AggregateResult::fromJson(const QJsonObject &obj)
+{
+	AggregateResult result;
+	result.m_query = Json::ensureIsType<AggregateQuery>(obj, "query");
+	result.m_revision = Json::ensureIsType<Revision>(obj, "revision");
+
+	const QVector<QString> &groupBy = result.m_query.groupBy();
+	const QVector<Aggregate> &aggregates = result.m_query.aggregates();
+	BaseValidator *validator = BaseValidator::getValidator(result.m_query.query().table());
+	for (const QJsonValue &groupValue : ensureArray(obj, "groups")) {
+		const QJsonObject group = Json::ensureObject(groupValue);
+		const QJsonArray keyArray = ensureArray(group, "key");
+		const QJsonArray valueArray = ensureArray(group, "values");
+		if (keyArray.size() != groupBy.size() || valueArray.size() != aggregates.size()) {
+			throw Exception("Aggregate group does not match the query");
+		}
+
+		QVector<QVariant> key;
+		for (int i = 0; i < keyArray.size(); ++i) {
+			key.append(coerce(validator, groupBy.at(i), keyArray.at(i).toVariant()));
+		}
+		QVector<QVariant> values;
+		for (int i = 0; i < valueArray.size(); ++i) {
+			const Aggregate &aggregate = aggregates.at(i);
+			const QVariant value = valueArray.at(i).toVariant();
+			switch (aggregate.function()) {
+			case Aggregate::Count: values.append(value.toLongLong()); break;
+			case Aggregate::Sum: values.append(value); break;
+			case Aggregate::Min:
+			case Aggregate::Max:
+				values.append(coerce(validator, aggregate.field(), value));
+				break;
+			}
+		}
+		result.m_groups.append(AggregateGroup(key, values));
+	}
+	return result;
+}
+QJsonObject AggregateResult::toJson() const
+{
+	QJsonArray groups;
+	for (const AggregateGroup &group : m_groups) {
+		groups.append(QJsonObject({
+									  {"key", variantsToJson(group.key())},
+									  {"values", variantsToJson(group.values())}
+								  }));
+	}
+	return QJsonObject({
+						   {"query", m_query.toJson()},
+						   {"groups", groups},
+						   {"revision", Json::toJson(m_revision)}
+					   });
+}
+
+}
+}
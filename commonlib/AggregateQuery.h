@@ -0,0 +1,115 @@
+#pragma once
+
+#include <QVariant>
+#include <QVector>
+
+#include "TableQuery.h"
+
+namespace Sportsed {
+namespace Common {
+
+class Aggregate
+{
+public:
+	enum Function
+	{
+		Count, ///< number of records, or of non-NULL values if a field is given
+		Sum,
+		Min,
+		Max
+	};
+
+	explicit Aggregate();
+	explicit Aggregate(const Function function, const QString &field = QString());
+
+	Function function() const { return m_function; }
+	void setFunction(const Function function) { m_function = function; }
+
+	const QString &field() const { return m_field; }
+	void setField(const QString &field) { m_field = field; }
+
+	static Aggregate fromJson(const QJsonObject &obj);
+	QJsonObject toJson() const;
+
+	bool operator==(const Aggregate &other) const;
+
+private:
+	Function m_function = Count;
+	QString m_field;
+};
+
+/// Computes aggregates over the records matching the filters of a query, optionally per distinct combination of the
+/// group by fields. Projections, sorting and pagination of the query are not supported
+class AggregateQuery
+{
+public:
+	explicit AggregateQuery();
+	explicit AggregateQuery(const TableQuery &query, const QVector<Aggregate> &aggregates,
+							const QVector<QString> &groupBy = {});
+
+	const TableQuery &query() const { return m_query; }
+	void setQuery(const TableQuery &query) { m_query = query; }
+
+	const QVector<Aggregate> &aggregates() const { return m_aggregates; }
+	void setAggregates(const QVector<Aggregate> &aggregates) { m_aggregates = aggregates; }
+
+	const QVector<QString> &groupBy() const { return m_groupBy; }
+	void setGroupBy(const QVector<QString> &groupBy) { m_groupBy = groupBy; }
+
+	static AggregateQuery fromJson(const QJsonObject &obj);
+	QJsonObject toJson() const;
+
+	bool operator==(const AggregateQuery &other) const;
+
+private:
+	TableQuery m_query;
+	QVector<Aggregate> m_aggregates;
+	QVector<QString> m_groupBy;
+};
+
+class AggregateGroup
+{
+public:
+	explicit AggregateGroup(const QVector<QVariant> &key = {}, const QVector<QVariant> &values = {});
+
+	/// Values of the group by fields, empty if the query is not grouped
+	const QVector<QVariant> &key() const { return m_key; }
+	/// One value per aggregate of the query, in the same order
+	const QVector<QVariant> &values() const { return m_values; }
+
+	bool operator==(const AggregateGroup &other) const;
+
+private:
+	QVector<QVariant> m_key;
+	QVector<QVariant> m_values;
+};
+
+class AggregateResult
+{
+public:
+	explicit AggregateResult();
+
+	const AggregateQuery &query() const { return m_query; }
+	void setQuery(const AggregateQuery &query) { m_query = query; }
+
+	/// Ordered by key. There is exactly one group if the query is not grouped, even if no records match
+	const QVector<AggregateGroup> &groups() const { return m_groups; }
+	void setGroups(const QVector<AggregateGroup> &groups) { m_groups = groups; }
+
+	/// Changes after this revision are not reflected in the result
+	Revision revision() const { return m_revision; }
+	void setRevision(const Revision revision) { m_revision = revision; }
+
+	static AggregateResult fromJson(const QJsonObject &obj);
+	QJsonObject toJson() const;
+
+private:
+	AggregateQuery m_query;
+	QVector<AggregateGroup> m_groups;
+	Revision m_revision = 0;
+};
+
+}
+}
+
+Q_DECLARE_METATYPE(Sportsed::Common::AggregateResult)
@@ -1,8 +1,13 @@
 #include "Change.h"
 
+#include <QHash>
+#include <algorithm>
+
 #include <jd-util/Functional.h>
 #include <jd-util/Json.h>
 
+#include "Schema.h"
+
 using namespace Sportsed::Common;
 using namespace JD::Util;
 
@@ -12,6 +17,75 @@ namespace Common {
 Change::Change(const Type &type)
 	: m_type(type) {}
 
+Change Change::toDelta() const
+{
+	if (m_type != Update || m_delta) {
+		return *this;
+	}
+
+	Record record(m_record.table());
+	record.setId(m_record.id());
+	record.setLatestRevision(m_record.latestRevision());
+	for (const QString &field : m_updatedFields) {
+		record.setValue(field, m_record.value(field));
+	}
+
+	Change change = *this;
+	change.m_record = record;
+	change.m_delta = true;
+	return change;
+}
+
+void ChangeCompactor::add(const Change &change)
+{
+	const QPair<Table, Id> key = qMakePair(change.m_record.table(), change.m_record.id());
+	if (!m_indices.contains(key)) {
+		m_indices.insert(key, m_net.size());
+		m_net.append(change);
+		m_cancelled.append(false);
+		return;
+	}
+
+	const int index = m_indices.value(key);
+	Change &previous = m_net[index];
+	switch (change.m_type) {
+	case Change::Create:
+		previous = change;
+		break;
+	case Change::Update:
+		// a create stays a create, just with the newer post-image
+		for (const QString &field : change.m_updatedFields) {
+			if (previous.m_type == Change::Update && !previous.m_updatedFields.contains(field)) {
+				previous.m_updatedFields.append(field);
+			}
+		}
+		previous.m_record = change.m_record;
+		previous.m_revision = change.m_revision;
+		break;
+	case Change::Delete:
+		if (previous.m_type == Change::Create) {
+			// the slot stays behind, but no longer holds on to the record
+			m_cancelled[index] = true;
+			previous = Change(Change::Delete);
+			m_indices.remove(key);
+		} else {
+			previous = change;
+		}
+		break;
+	}
+}
+QVector<Change> ChangeCompactor::changes() const
+{
+	QVector<Change> result;
+	for (int i = 0; i < m_net.size(); ++i) {
+		if (!m_cancelled.at(i)) {
+			result.append(m_net.at(i));
+		}
+	}
+	std::sort(result.begin(), result.end(), [](const Change &a, const Change &b) { return a.m_revision < b.m_revision; });
+	return result;
+}
+
 Change Change::fromJson(const QJsonObject &obj)
 {
 	Type t;
@@ -27,7 +101,10 @@ Change Change::fromJson(const QJsonObject &obj)
 	Change change = Change(t);
 	change.m_record = Json::ensureIsType<Record>(obj, "record");
 	change.m_revision = Json::ensureIsType<Revision>(obj, "revision");
-	change.m_updatedFields = Json::ensureIsArrayOf<QString>(obj, "fields");
+	for (const QString &field : Json::ensureIsArrayOf<QString>(obj, "fields")) {
+		change.m_updatedFields.append(sharedFieldName(change.m_record.table(), field));
+	}
+	change.m_delta = obj.value("delta").toBool();
 	return change;
 }
 QJsonObject Change::toJson() const
@@ -41,6 +118,9 @@ QJsonObject Change::toJson() const
 	case Delete: obj.insert("type", "delete"); break;
 	}
 	obj.insert("fields", Json::toJsonArray(m_updatedFields));
+	if (m_delta) {
+		obj.insert("delta", true);
+	}
 	return obj;
 }
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <QVector>
+#include <QHash>
+#include <utility>
 #include <QJsonObject>
 
 #include "Record.h"
@@ -20,16 +22,22 @@ public:
 
 	explicit Change(const Type &type = Create);
 
-	Record record() const { return m_record; }
+	const Record &record() const { return m_record; }
 	void setRecord(const Record &rec) { m_record = rec; }
+	void setRecord(Record &&rec) { m_record = std::move(rec); }
 
 	Revision revision() const { return m_revision; }
 	void setRevision(const Revision revision) { m_revision = revision; }
 
 	Type type() const { return m_type; }
 
-	QVector<QString> updatedFields() const { return m_updatedFields; }
+	const QVector<QString> &updatedFields() const { return m_updatedFields; }
 	void setUpdatedFields(const QVector<QString> &fields) { m_updatedFields = fields; }
+	void setUpdatedFields(QVector<QString> &&fields) { m_updatedFields = std::move(fields); }
+
+	/// A delta change only carries the id, revision and updated values of the record
+	bool isDelta() const { return m_delta; }
+	Change toDelta() const;
 
 	static Change fromJson(const QJsonObject &obj);
 	QJsonObject toJson() const;
@@ -39,6 +47,25 @@ private:
 	Revision m_revision;
 	Type m_type;
 	QVector<QString> m_updatedFields;
+	bool m_delta = false;
+
+	friend class ChangeCompactor;
+};
+
+/// Merges changes into their net effect one at a time, only holding one change per record. All changes to the same record
+/// end up as one net change, a create followed by a delete cancels out
+class ChangeCompactor
+{
+public:
+	/// Changes have to be added in the order of their revisions
+	void add(const Change &change);
+	/// The net changes, ordered by revision
+	QVector<Change> changes() const;
+
+private:
+	QVector<Change> m_net;
+	QVector<bool> m_cancelled;
+	QHash<QPair<Table, Id>, int> m_indices;
 };
 
 }
@@ -19,12 +19,21 @@ public:
 	Revision fromRevision() const { return m_fromRevision; }
 	void setFromRevision(const Revision revision) { m_fromRevision = revision; }
 
-	TableQuery query() const { return m_query; }
+	const TableQuery &query() const { return m_query; }
 	void setQuery(const TableQuery &table) { m_query = table; }
 
+	/// If set, updates are delivered as delta changes (see Change::toDelta)
+	bool isDelta() const { return m_delta; }
+	void setDelta(const bool delta) { m_delta = delta; }
+
+	/// If set, changes() merges all changes to a record into one net change (see ChangeCompactor)
+	bool isCompact() const { return m_compact; }
+	void setCompact(const bool compact) { m_compact = compact; }
+
 	static ChangeQuery fromJson(const QJsonObject &obj);
 	QJsonObject toJson() const;
 
+	/// Compiles the query on every call, keep a QueryPredicate around for matching many changes
 	bool matches(const Change &change, const Record &record) const;
 
 	bool operator==(const ChangeQuery &other) const;
@@ -32,6 +41,8 @@ public:
 private:
 	Revision m_fromRevision = 0;
 	TableQuery m_query;
+	bool m_delta = false;
+	bool m_compact = false;
 };
 
 }
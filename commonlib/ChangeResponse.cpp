@@ -15,15 +15,21 @@ ChangeResponse ChangeResponse::fromJson(const QJsonObject &obj)
 	response.m_query = Json::ensureIsType<ChangeQuery>(obj, "query");
 	response.m_changes = Json::ensureIsArrayOf<Change>(obj, "changes");
 	response.m_lastRevision = Json::ensureIsType<Revision>(obj, "last_revision");
+	response.m_resyncRequired = obj.value("resync").toBool();
 	return response;
 }
 
 QJsonObject ChangeResponse::toJson() const
+{
+	return toJson(Json::toJsonArray(m_changes));
+}
+QJsonObject ChangeResponse::toJson(const QJsonArray &changes) const
 {
 	return QJsonObject({
 						   {"query", m_query.toJson()},
-						   {"changes", Json::toJsonArray(m_changes)},
-						   {"last_revision", Json::toJson(m_lastRevision)}
+						   {"changes", changes},
+						   {"last_revision", Json::toJson(m_lastRevision)},
+						   {"resync", m_resyncRequired}
 					   });
 }
 
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <QVector>
+#include <QJsonArray>
+#include <utility>
 
 #include "ChangeQuery.h"
 #include "Change.h"
@@ -14,22 +16,30 @@ class ChangeResponse
 public:
 	explicit ChangeResponse();
 
-	ChangeQuery query() const { return m_query; }
+	const ChangeQuery &query() const { return m_query; }
 	void setQuery(const ChangeQuery &query) { m_query = query; }
 
-	QVector<Change> changes() const { return m_changes; }
+	const QVector<Change> &changes() const { return m_changes; }
 	void setChanges(const QVector<Change> &changes) { m_changes = changes; }
+	void setChanges(QVector<Change> &&changes) { m_changes = std::move(changes); }
 
 	Revision lastRevision() const { return m_lastRevision; }
 	void setLastRevision(const Revision revision) { m_lastRevision = revision; }
 
+	/// Set if the requested revision is older than the retained change log, clients then have to reload their data
+	bool isResyncRequired() const { return m_resyncRequired; }
+	void setResyncRequired(const bool resync) { m_resyncRequired = resync; }
+
 	static ChangeResponse fromJson(const QJsonObject &obj);
 	QJsonObject toJson() const;
+	/// Uses the given changes instead of serializing changes(), which allows many responses to share them
+	QJsonObject toJson(const QJsonArray &changes) const;
 
 private:
 	ChangeQuery m_query;
 	QVector<Change> m_changes;
 	Revision m_lastRevision;
+	bool m_resyncRequired = false;
 };
 
 }
@@ -0,0 +1,50 @@
+#include "Intern.h"
+
+#include <QSet>
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace Sportsed {
+namespace Common {
+
+namespace detail {
+static constexpr int maxInternedLength = 64;
+static constexpr int maxInternedStrings = 1 << 16;
+
+struct InternTable
+{
+	// records are decoded on a single thread in both the server and the clients, so the lock is uncontended and costs
+	// a single atomic operation. it is only there to keep worker threads that decode records safe
+	QMutex mutex;
+	QSet<QString> strings;
+};
+Q_GLOBAL_STATIC(InternTable, internTable)
+}
+
+QString intern(const QString &str)
+{
+	if (str.isEmpty() || str.size() > detail::maxInternedLength) {
+		return str;
+	}
+
+	detail::InternTable *table = detail::internTable;
+	QMutexLocker locker(&table->mutex);
+	const auto it = table->strings.constFind(str);
+	if (it != table->strings.constEnd()) {
+		return *it;
+	}
+	if (table->strings.size() < detail::maxInternedStrings) {
+		table->strings.insert(str);
+	}
+	return str;
+}
+QVariant intern(const QVariant &value)
+{
+	if (value.type() != QVariant::String) {
+		return value;
+	}
+	return intern(value.toString());
+}
+
+}
+}
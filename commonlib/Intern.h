@@ -0,0 +1,19 @@
+#pragma once
+
+#include <QString>
+#include <QVariant>
+
+namespace Sportsed {
+namespace Common {
+
+/// Returns a string equal to the given one that shares its storage with all other interned copies of it
+///
+/// Only meant for the values of fields with few distinct values (class names, disciplines etc.), see internValue(), as
+/// strings are never removed again. The table is process-wide and thread-safe. Long strings, and any string once the
+/// table is full, are returned as is.
+QString intern(const QString &str);
+/// Interns the value if it is a string, other values are returned as is
+QVariant intern(const QVariant &value);
+
+}
+}
@@ -28,15 +28,20 @@ void MessageSocket::send(const QByteArray &msg)
 	if (!m_device || !m_device->isOpen()) {
 		throw SocketNotOpenException();
 	}
-	const int size = msg.size();
+	// the top bit of the size marks compressed messages, JSON compresses well enough to make up for the time it takes
+	const bool compressed = m_compressionThreshold > 0 && msg.size() >= m_compressionThreshold;
+	const QByteArray payload = compressed ? qCompress(msg) : msg;
+	const int size = payload.size();
 	QByteArray sizeData(4, 0);
-	sizeData[0] = static_cast<char>(size >> 24);
+	sizeData[0] = static_cast<char>((size >> 24) | (compressed ? 0x80 : 0));
 	sizeData[1] = static_cast<char>(size >> 16);
 	sizeData[2] = static_cast<char>(size >> 8);
 	sizeData[3] = static_cast<char>(size >> 0);
-	const qint64 sentSize = m_device->write(sizeData) + m_device->write(msg);
+	const qint64 sentSize = m_device->write(sizeData) + m_device->write(payload);
 	if (sentSize < (size + 4)) {
 		throw SocketWriteException("Unable to write data to socket: " + m_device->errorString());
+	} else if (compressed) {
+		qCDebug(messageSocket) << "sent" << size << "bytes of compressed data," << msg.size() << "bytes uncompressed:" << msg;
 	} else {
 		qCDebug(messageSocket) << "sent" << size << "bytes of data:" << msg;
 	}
@@ -53,8 +58,9 @@ void MessageSocket::dataReady()
 			} else {
 				const QByteArray sizeData = m_device->read(4);
 				Q_ASSERT(!sizeData.isNull() && !sizeData.isEmpty());
+				m_currentMessageCompressed = (static_cast<unsigned char>(sizeData.at(0)) & 0x80) != 0;
 				m_currentMessageSize =
-						(static_cast<unsigned char>(sizeData.at(0)) << 24) |
+						(static_cast<unsigned char>(sizeData.at(0) & 0x7f) << 24) |
 						(static_cast<unsigned char>(sizeData.at(1)) << 16) |
 						(static_cast<unsigned char>(sizeData.at(2)) << 8) |
 						(static_cast<unsigned char>(sizeData.at(3)) << 0);
@@ -67,6 +73,9 @@ void MessageSocket::dataReady()
 		}
 
 		if (m_buffer.size() == m_currentMessageSize) {
+			if (m_currentMessageCompressed) {
+				m_buffer = qUncompress(m_buffer);
+			}
 			qCDebug(messageSocket) << "received" << m_currentMessageSize << "bytes of data:" << m_buffer;
 			message(m_buffer);
 			m_buffer.clear();
@@ -22,6 +22,11 @@ public:
 
 	void setDevice(QIODevice *device);
 
+	/// Messages of at least this many bytes are sent compressed, 0 disables compression. Receiving compressed messages
+	/// is always supported
+	int compressionThreshold() const { return m_compressionThreshold; }
+	void setCompressionThreshold(const int bytes) { m_compressionThreshold = bytes; }
+
 public slots:
 	virtual void send(const QByteArray &msg);
 
@@ -30,7 +35,9 @@ signals:
 
 private:
 	int m_currentMessageSize = -1;
+	bool m_currentMessageCompressed = false;
 	QByteArray m_buffer;
+	int m_compressionThreshold = 16 * 1024;
 
 	QIODevice *m_device = nullptr;
 
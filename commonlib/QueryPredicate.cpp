@@ -0,0 +1,197 @@
+#include "QueryPredicate.h"
+
+#include <algorithm>
+
+#include "Schema.h"
+#include "Validators.h"
+
+namespace Sportsed {
+namespace Common {
+
+static QVariant coerce(BaseValidator *validator, const int fieldIndex, const QVariant &value)
+{
+	if (!validator) {
+		return value;
+	}
+	try {
+		return validator->coerce(fieldIndex, value);
+	} catch (CoercionException &) {
+		return value; // compared as is
+	}
+}
+
+QueryPredicate::QueryPredicate(const TableQuery &query)
+	: m_table(query.table())
+{
+	for (const TableFilter &filter : query.filters()) {
+		compile(filter);
+	}
+
+	if (!query.after().isEmpty()) {
+		const TableSchema &schema = tableSchema(m_table);
+		for (int i = 0; i < query.sort().size() && i < query.after().size(); ++i) {
+			const TableSort &sort = query.sort().at(i);
+			m_cursor.append(SortKey{sort.field() == "id", schema.indexOf(sort.field()), sort.isDescending(), query.after().at(i)});
+		}
+		if (query.after().size() > query.sort().size()) {
+			m_afterId = query.after().at(query.sort().size()).value<Id>();
+		}
+	}
+}
+
+void QueryPredicate::compile(const TableFilter &filter)
+{
+	const int index = m_nodes.size();
+	Node node;
+	node.op = filter.op();
+	m_nodes.append(node);
+
+	if (filter.isGroup()) {
+		for (const TableFilter &child : filter.children()) {
+			compile(child);
+		}
+		m_nodes[index].size = m_nodes.size() - index;
+		return;
+	}
+
+	BaseValidator *validator = BaseValidator::getValidator(m_table);
+	if (filter.field() == "id") {
+		node.target = Node::RecordId;
+	} else if (filter.field().contains('>')) {
+		node.target = Node::ReferencedField;
+	} else {
+		node.slot = m_table == Table::Null ? -1 : tableSchema(m_table).indexOf(filter.field());
+		node.target = node.slot == -1 ? Node::UnknownField : Node::FieldSlot;
+	}
+
+	// values of referenced and unknown fields are compared as they are
+	const auto convert = [&node, validator](const QVariant &value) {
+		switch (node.target) {
+		case Node::RecordId: return QVariant::fromValue(value.value<Id>());
+		case Node::FieldSlot: return coerce(validator, node.slot, value);
+		case Node::ReferencedField:
+		case Node::UnknownField:
+			return value;
+		}
+	};
+	switch (node.op) {
+	case TableFilter::In:
+	case TableFilter::Between:
+		for (const QVariant &value : filter.value().toList()) {
+			node.values.append(convert(value));
+		}
+		break;
+	case TableFilter::StartsWith:
+		node.value = filter.value().toString();
+		break;
+	case TableFilter::IsNull:
+		node.value = filter.value().toBool();
+		break;
+	default:
+		node.value = convert(filter.value());
+		break;
+	}
+	m_nodes[index] = node;
+}
+
+bool QueryPredicate::matches(const Record &record) const
+{
+	if (record.table() != m_table) {
+		return false;
+	}
+	for (int i = 0; i < m_nodes.size(); i += m_nodes.at(i).size) {
+		const Truth result = evaluate(i, record);
+		if (result != Truth::True && result != Truth::Maybe) {
+			return false;
+		}
+	}
+	return isAfterCursor(record);
+}
+
+QueryPredicate::Truth QueryPredicate::evaluate(const int index, const Record &record) const
+{
+	const Node &node = m_nodes.at(index);
+	const int end = index + node.size;
+	switch (node.op) {
+	case TableFilter::And: {
+		Truth result = Truth::True;
+		for (int child = index + 1; child < end && result != Truth::False; child += m_nodes.at(child).size) {
+			result = std::min(result, evaluate(child, record));
+		}
+		return result;
+	}
+	case TableFilter::Or: {
+		Truth result = Truth::False;
+		for (int child = index + 1; child < end && result != Truth::True; child += m_nodes.at(child).size) {
+			result = std::max(result, evaluate(child, record));
+		}
+		return result;
+	}
+	case TableFilter::Not: {
+		const Truth result = node.size == 1 ? Truth::Maybe : evaluate(index + 1, record);
+		return result == Truth::True ? Truth::False : result == Truth::False ? Truth::True : result;
+	}
+	default:
+		break;
+	}
+
+	QVariant value;
+	switch (node.target) {
+	case Node::FieldSlot:
+		if (!record.hasValue(node.slot)) {
+			return Truth::False;
+		}
+		value = record.value(node.slot);
+		break;
+	case Node::RecordId:
+		value = QVariant::fromValue(record.id());
+		break;
+	case Node::ReferencedField: return Truth::Maybe;
+	case Node::UnknownField: return Truth::False;
+	}
+
+	if (node.op == TableFilter::IsNull) {
+		return value.isNull() == node.value.toBool() ? Truth::True : Truth::False;
+	} else if (value.isNull()) {
+		return Truth::Null;
+	}
+
+	bool result = false;
+	switch (node.op) {
+	case TableFilter::Equal: result = value == node.value; break;
+	case TableFilter::NotEqual: result = value != node.value; break;
+	case TableFilter::Less: result = value < node.value; break;
+	case TableFilter::LessEqual: result = value <= node.value; break;
+	case TableFilter::Greater: result = value > node.value; break;
+	case TableFilter::GreaterEqual: result = value >= node.value; break;
+	case TableFilter::In: result = node.values.contains(value); break;
+	case TableFilter::Between:
+		result = node.values.size() == 2 && node.values.at(0) <= value && value <= node.values.at(1);
+		break;
+	case TableFilter::StartsWith: result = value.toString().startsWith(node.value.toString()); break;
+	case TableFilter::IsNull:
+	case TableFilter::And:
+	case TableFilter::Or:
+	case TableFilter::Not:
+		break; // handled above
+	}
+	return result ? Truth::True : Truth::False;
+}
+
+bool QueryPredicate::isAfterCursor(const Record &record) const
+{
+	if (m_cursor.isEmpty() && m_afterId == 0) {
+		return true;
+	}
+	for (const SortKey &key : m_cursor) {
+		const QVariant value = key.isId ? QVariant::fromValue(record.id()) : record.value(key.slot);
+		const int comparison = key.descending ? TableSort::compare(key.after, value) : TableSort::compare(value, key.after);
+		if (comparison != 0) {
+			return comparison > 0;
+		}
+	}
+	return m_afterId < record.id();
+}
+
+}
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <QVector>
+#include <QVariant>
+
+#include "TableQuery.h"
+#include "Record.h"
+
+namespace Sportsed {
+namespace Common {
+
+/// The filters and cursor of a TableQuery resolved against the table schema once, for evaluating them against many
+/// records without looking up fields by name
+class QueryPredicate
+{
+public:
+	explicit QueryPredicate(const TableQuery &query = TableQuery(Table::Null));
+
+	/// Whether the record may be part of the result of the query, filters on fields of referenced records are assumed
+	/// to match since they can not be evaluated without the referenced records
+	bool matches(const Record &record) const;
+
+private:
+	/// Null is the SQL NULL that comparisons with NULL yield, Maybe is either True or False. Ordered such that AND is the
+	/// minimum and OR the maximum
+	enum class Truth
+	{
+		False,
+		Null,
+		Maybe,
+		True
+	};
+
+	struct Node
+	{
+		enum Target
+		{
+			FieldSlot,
+			RecordId,
+			ReferencedField, // multi-level field
+			UnknownField
+		};
+
+		TableFilter::Operator op;
+		Target target = UnknownField;
+		int slot = -1;
+		QVariant value; // coerced to the type of the field
+		QVector<QVariant> values; // In and Between
+		int size = 1; // number of nodes in this subtree, children directly follow their parent
+	};
+	struct SortKey
+	{
+		bool isId;
+		int slot;
+		bool descending;
+		QVariant after;
+	};
+
+	Table m_table;
+	QVector<Node> m_nodes; // one subtree per top-level filter
+	QVector<SortKey> m_cursor; // empty if there is no cursor
+	Id m_afterId = 0;
+
+	void compile(const TableFilter &filter);
+	Truth evaluate(const int index, const Record &record) const;
+	bool isAfterCursor(const Record &record) const;
+};
+
+}
+}
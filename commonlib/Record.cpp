@@ -2,45 +2,220 @@
 
 #include <jd-util/Json.h>
 #include <QDebug>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonObject>
 
 #include "Validators.h"
+#include "Schema.h"
 
 using namespace JD::Util;
 
 namespace Sportsed {
 namespace Common {
 
-Record::Record(const Table table, const QHash<QString, QVariant> &values) : m_table(table), m_values(values) {}
+QJsonArray ensureArray(const QJsonObject &obj, const QString &key)
+{
+	const QJsonValue value = Json::ensureValue(obj, key);
+	if (!value.isArray()) {
+		throw Exception(QStringLiteral("Expected '%1' to be an array").arg(key));
+	}
+	return value.toArray();
+}
+
+Record::Record(const Table table, const QHash<QString, QVariant> &values) : d(new detail::RecordData)
+{
+	d->table = table;
+	setValues(values);
+}
+
+void Record::setTable(const Table &table)
+{
+	if (table == d->table) {
+		return;
+	}
+	if (!hasValues()) {
+		d->table = table;
+		return;
+	}
+	// slots are specific to the schema of a table
+	const QHash<QString, QVariant> values = this->values();
+	d->table = table;
+	setValues(values);
+}
+
+int Record::fieldIndex(const QString &name) const
+{
+	return tableSchema(d->table).indexOf(name);
+}
+
+QVariant Record::value(const QString &name) const
+{
+	const int index = fieldIndex(name);
+	return index == -1 ? d->extra.value(name) : value(index);
+}
+void Record::setValue(const QString &name, const QVariant &value)
+{
+	const int index = fieldIndex(name);
+	if (index == -1) {
+		d->extra.insert(name, value);
+	} else {
+		setValue(index, value);
+	}
+}
+void Record::setValue(const int index, const QVariant &value)
+{
+	if (d->slotValues.isEmpty()) {
+		d->slotValues.resize(tableSchema(d->table).fieldCount);
+	}
+	d->slotValues[index] = value;
+	d->present |= quint64(1) << index;
+}
+bool Record::hasValue(const QString &name) const
+{
+	const int index = fieldIndex(name);
+	return index == -1 ? d->extra.contains(name) : hasValue(index);
+}
+
+QVector<QString> Record::fields() const
+{
+	QVector<QString> fields;
+	const QVector<QString> &names = fieldNames(d->table);
+	for (int i = 0; i < names.size(); ++i) {
+		if (hasValue(i)) {
+			fields.append(names.at(i));
+		}
+	}
+	for (auto it = d->extra.cbegin(); it != d->extra.cend(); ++it) {
+		fields.append(it.key());
+	}
+	return fields;
+}
+
+QHash<QString, QVariant> Record::values() const
+{
+	QHash<QString, QVariant> values = d->extra;
+	const QVector<QString> &names = fieldNames(d->table);
+	for (int i = 0; i < names.size(); ++i) {
+		if (hasValue(i)) {
+			values.insert(names.at(i), d->slotValues.at(i));
+		}
+	}
+	return values;
+}
+void Record::setValues(const QHash<QString, QVariant> &values)
+{
+	d->slotValues.clear();
+	d->present = 0;
+	d->extra.clear();
+	for (auto it = values.cbegin(); it != values.cend(); ++it) {
+		setValue(it.key(), it.value());
+	}
+}
+
+/// Decodes values that are in the same representation toJson() produces for them, the result is the same as from
+/// BaseValidator::coerce()
+static bool decodeValue(const BaseValidator::FieldType type, const QJsonValue &json, QVariant &out)
+{
+	switch (type) {
+	case BaseValidator::ID:
+		if (json.isDouble()) {
+			out = QVariant::fromValue<Id>(Id(qRound64(json.toDouble())));
+			return true;
+		}
+		return false;
+	case BaseValidator::Integer:
+		if (json.isDouble()) {
+			out = QVariant(qlonglong(qRound64(json.toDouble())));
+			return true;
+		}
+		return false;
+	case BaseValidator::Real:
+		if (json.isDouble()) {
+			out = json.toDouble();
+			return true;
+		}
+		return false;
+	case BaseValidator::Boolean:
+		if (json.isBool()) {
+			out = json.toBool();
+			return true;
+		}
+		return false;
+	case BaseValidator::String:
+	case BaseValidator::IP:
+	case BaseValidator::JSON:
+		if (json.isString()) {
+			out = json.toString();
+			return true;
+		}
+		return false;
+	case BaseValidator::Date: {
+		const QDate date = QDate::fromString(json.toString(), Qt::ISODate);
+		out = date;
+		return json.isString() && date.isValid();
+	}
+	case BaseValidator::Time: {
+		const QTime time = QTime::fromString(json.toString(), Qt::ISODate);
+		out = time;
+		return json.isString() && time.isValid();
+	}
+	case BaseValidator::DateTime: {
+		const QDateTime dateTime = QDateTime::fromString(json.toString(), Qt::ISODate);
+		out = dateTime;
+		return json.isString() && dateTime.isValid();
+	}
+	default:
+		return false;
+	}
+}
 
 Record Record::fromJson(const QJsonObject &obj)
 {
 	Record record(fromTableName(Json::ensureString(obj, "table")));
 	if (obj.value("id").isDouble()) {
-		record.m_id = Json::ensureIsType<Id>(obj, "id");
+		record.d->id = Json::ensureIsType<Id>(obj, "id");
 	}
-	record.m_latestRevision = Json::ensureIsType<Revision>(obj, "latest_revision");
-	record.m_values = Json::ensureIsHashOf<QVariant>(obj, "values");
-	return BaseValidator::getValidator(record.m_table)->coerceRecord(record);
+	record.d->latestRevision = Json::ensureIsType<Revision>(obj, "latest_revision");
+
+	// values are decoded straight into their slots, only values that are not in their usual JSON representation go
+	// through the generic coercion
+	const TableSchema &schema = tableSchema(record.d->table);
+	BaseValidator *validator = BaseValidator::getValidator(record.d->table);
+	const QJsonObject values = Json::ensureObject(obj, "values");
+	for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+		const int index = schema.indexOf(it.key());
+		if (index == -1) {
+			throw UnknownFieldException();
+		}
+		QVariant value;
+		if (!decodeValue(schema.field(index).type, it.value(), value)) {
+			value = validator->coerce(index, it.value().toVariant());
+		}
+		// values such as class names repeat over many records
+		record.setValue(index, internValue(schema.field(index), value));
+	}
+	return record;
 }
 QJsonValue Record::toJson() const
 {
-	if (m_table == Table::Null) {
+	if (d->table == Table::Null) {
 		return QJsonValue();
 	}
 	return QJsonObject({
-						   {"table", tableName(m_table)},
-						   {"id", bool(m_id) ? Json::toJson(m_id.value_or(0)) : QJsonValue()},
-						   {"latest_revision", Json::toJson(m_latestRevision)},
-						   {"values", Json::toJsonObject(m_values)}
+						   {"table", tableName(d->table)},
+						   {"id", bool(d->id) ? Json::toJson(d->id.value_or(0)) : QJsonValue()},
+						   {"latest_revision", Json::toJson(d->latestRevision)},
+						   {"values", Json::toJsonObject(values())}
 					   });
 }
 
 QVector<QString> Record::changesBetween(const Record &record) const
 {
 	QVector<QString> changes;
-	for (auto it = m_values.cbegin(); it != m_values.cend(); ++it) {
-		if (it.value() != record.value(it.key())) {
-			changes.append(it.key());
+	for (const QString &field : fields()) {
+		if (value(field) != record.value(field)) {
+			changes.append(field);
 		}
 	}
 	return changes;
@@ -48,51 +223,19 @@ QVector<QString> Record::changesBetween(const Record &record) const
 
 bool Record::operator==(const Record &other) const
 {
-	return m_table == other.m_table && m_id == other.m_id &&
-			m_values == other.m_values && m_latestRevision == other.m_latestRevision;
-}
-
-QString tableName(const Table table)
-{
-	switch (table) {
-	case Table::Null: throw SerializeNullTableNameException();
-	case Table::Meta: return "meta";
-	case Table::Change: return "change";
-	case Table::Profile: return "profile";
-	case Table::Client: return "client";
-	case Table::Competition: return "competition";
-	case Table::Stage: return "stage";
-	case Table::Course: return "course";
-	case Table::Control: return "control";
-	case Table::CourseControl: return "course_control";
-	case Table::Class: return "class";
-	}
-}
-Table fromTableName(const QString &str)
-{
-	if (str == "meta") {
-		return Table::Meta;
-	} else if (str == "change") {
-		return Table::Change;
-	} else if (str == "profile") {
-		return Table::Profile;
-	} else if (str == "client") {
-		return Table::Client;
-	} else if (str == "competition") {
-		return Table::Competition;
-	} else if (str == "stage") {
-		return Table::Stage;
-	} else if (str == "course") {
-		return Table::Course;
-	} else if (str == "control") {
-		return Table::Control;
-	} else if (str == "course_control") {
-		return Table::CourseControl;
-	} else if (str == "class") {
-		return Table::Class;
-	} else {
-		throw InvalidTableNameException();
+	if (d == other.d) {
+		return true;
+	}
+	if (d->table != other.d->table || d->id != other.d->id || d->latestRevision != other.d->latestRevision ||
+			d->present != other.d->present || d->extra != other.d->extra) {
+		return false;
+	}
+	for (int i = 0; i < d->slotValues.size(); ++i) {
+		if (hasValue(i) && d->slotValues.at(i) != other.d->slotValues.at(i)) {
+			return false;
+		}
 	}
+	return true;
 }
 
 }
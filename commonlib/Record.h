@@ -2,6 +2,8 @@
 
 #include <QHash>
 #include <QVariant>
+#include <QVector>
+#include <QSharedData>
 
 #include <jd-util/Exception.h>
 
@@ -43,32 +45,64 @@ DECLARE_EXCEPTION(InvalidTableName)
 QString tableName(const Table table);
 Table fromTableName(const QString &str);
 
+/// Counterpart to the Json::ensure* helpers for array members
+QJsonArray ensureArray(const QJsonObject &obj, const QString &key);
+
+namespace detail {
+class RecordData : public QSharedData
+{
+public:
+	Table table = Table::Null;
+	std::optional<Id> id;
+	Revision latestRevision = 0;
+	/// Values indexed by their position in the table schema, only valid if the corresponding bit in present is set
+	QVector<QVariant> slotValues;
+	quint64 present = 0;
+	/// Fields that are not part of the schema, kept so that validation is able to reject them
+	QHash<QString, QVariant> extra;
+	bool complete = false;
+};
+}
+
+/// Copies of a record share their data until one of them is modified
 class Record
 {
 public:
 	explicit Record(const Table table = Table::Null, const QHash<QString, QVariant> &values = {});
 
-	bool isNull() const { return m_table == Table::Null; }
-	bool isPersisted() const { return bool(m_id); }
+	bool isNull() const { return d->table == Table::Null; }
+	bool isPersisted() const { return bool(d->id); }
+
+	Table table() const { return d->table; }
+	void setTable(const Table &table);
+
+	Id id() const { return d->id.value_or(0); }
+	void setId(const Id id) { d->id = id; }
+	void unsetId() { d->id = {}; }
 
-	Table table() const { return m_table; }
-	void setTable(const Table &table) { m_table = table; }
+	Revision latestRevision() const { return d->latestRevision; }
+	void setLatestRevision(const Revision revision) { d->latestRevision = revision; }
 
-	Id id() const { return m_id.value_or(0); }
-	void setId(const Id id) { m_id = id; }
-	void unsetId() { m_id = {}; }
+	/// Index of the field in the table schema, -1 if the table has no such field
+	int fieldIndex(const QString &name) const;
 
-	Revision latestRevision() const { return m_latestRevision; }
-	void setLatestRevision(const Revision revision) { m_latestRevision = revision; }
+	QVariant value(const QString &name) const;
+	QVariant value(const int index) const { return d->slotValues.value(index); }
+	void setValue(const QString &name, const QVariant &value);
+	void setValue(const int index, const QVariant &value);
+	bool hasValue(const QString &name) const;
+	bool hasValue(const int index) const { return d->present & (quint64(1) << index); }
+	bool hasValues() const { return d->present != 0 || !d->extra.isEmpty(); }
 
-	QVariant value(const QString &name) const { return m_values.value(name); }
-	void setValue(const QString &name, const QVariant &value) { m_values.insert(name, value); }
+	/// Names of all fields that have a value, in schema order
+	QVector<QString> fields() const;
 
-	QHash<QString, QVariant> values() const { return m_values; }
-	void setValues(const QHash<QString, QVariant> &values) { m_values = values; }
+	/// Assembled on every call, prefer fields() and value() where possible
+	QHash<QString, QVariant> values() const;
+	void setValues(const QHash<QString, QVariant> &values);
 
-	bool isComplete() const { return m_complete; }
-	void setComplete(const bool complete) { m_complete = complete; }
+	bool isComplete() const { return d->complete; }
+	void setComplete(const bool complete) { d->complete = complete; }
 
 	static Record fromJson(const QJsonObject &obj);
 	QJsonValue toJson() const;
@@ -78,11 +112,7 @@ public:
 	bool operator==(const Record &other) const;
 
 private:
-	Table m_table;
-	std::optional<Id> m_id;
-	Revision m_latestRevision = 0;
-	QHash<QString, QVariant> m_values;
-	bool m_complete = false;
+	QSharedDataPointer<detail::RecordData> d;
 };
 
 }
@@ -0,0 +1,183 @@
+#include "Schema.h"
+
+#include <QHash>
+
+#include "Intern.h"
+
+namespace Sportsed {
+namespace Common {
+
+namespace detail {
+
+static constexpr FieldSchema meta[] = {
+	{"key", BaseValidator::String, "VARCHAR(64) NOT NULL"},
+	{"value", BaseValidator::String, "VARCHAR(256)"}
+};
+static constexpr FieldSchema change[] = {
+	{"type", BaseValidator::Char, "CHAR(1) NOT NULL"},
+	{"record_id", BaseValidator::ID, "INT NOT NULL"},
+	{"record_table", BaseValidator::String, "VARCHAR(32) NOT NULL"},
+	{"timestamp", BaseValidator::Integer, "INT NOT NULL"},
+	{"fields", BaseValidator::String, "VARCHAR(256) DEFAULT NULL"},
+	{"data", BaseValidator::String, "TEXT DEFAULT NULL"}
+};
+static constexpr FieldSchema profile[] = {
+	{"type", BaseValidator::String, "VARCHAR(16) NOT NULL", true},
+	{"name", BaseValidator::String, "VARCHAR(64) NOT NULL"},
+	{"value", BaseValidator::JSON, "TEXT NOT NULL"}
+};
+static constexpr FieldSchema client[] = {
+	{"name", BaseValidator::String, "VARCHAR(64) NOT NULL"},
+	{"ip", BaseValidator::IP, "VARCHAR(32) NOT NULL"}
+};
+static constexpr FieldSchema competition[] = {
+	{"name", BaseValidator::String, "VARCHAR(128) NOT NULL"},
+	{"sport", BaseValidator::String, "VARCHAR(64) NOT NULL", true}
+};
+static constexpr FieldSchema stage[] = {
+	{"competition_id", BaseValidator::ID, "FK NOT NULL"},
+	{"name", BaseValidator::String, "VARCHAR(128) NOT NULL"},
+	{"type", BaseValidator::String, "VARCHAR(64) NOT NULL", true},
+	{"discipline", BaseValidator::String, "VARCHAR(64) NOT NULL", true},
+	{"date", BaseValidator::Date, "DATE NOT NULL"},
+	{"in_totals", BaseValidator::Boolean, "BOOLEAN NOT NULL DEFAULT TRUE"}
+};
+static constexpr FieldSchema course[] = {
+	{"stage_id", BaseValidator::ID, "FK"},
+	{"name", BaseValidator::String, "VARCHAR(64) NOT NULL", true}
+};
+static constexpr FieldSchema control[] = {
+	{"stage_id", BaseValidator::ID, "FK"},
+	{"name", BaseValidator::String, "VARCHAR(5) NOT NULL", true},
+	{"special", BaseValidator::String, "VARCHAR(256) NOT NULL DEFAULT ''", true}
+};
+static constexpr FieldSchema courseControl[] = {
+	{"control_id", BaseValidator::ID, "FK"},
+	{"course_id", BaseValidator::ID, "FK"},
+	{"order", BaseValidator::Integer, "INTEGER NOT NULL"},
+	{"distance_from_previous", BaseValidator::Real, "DOUBLE"}
+};
+static constexpr FieldSchema class_[] = {
+	{"stage_id", BaseValidator::ID, "FK"},
+	{"name", BaseValidator::String, "VARCHAR(64)", true}
+};
+
+template <std::size_t N>
+static constexpr TableSchema makeTable(const Table table, const char *name, const FieldSchema (&fields)[N])
+{
+	return TableSchema{table, name, fields, int(N)};
+}
+
+static constexpr TableSchema tables[] = {
+	{Table::Null, nullptr, nullptr, 0},
+	makeTable(Table::Meta, "meta", meta),
+	makeTable(Table::Change, "change", change),
+	makeTable(Table::Profile, "profile", profile),
+	makeTable(Table::Client, "client", client),
+	makeTable(Table::Competition, "competition", competition),
+	makeTable(Table::Stage, "stage", stage),
+	makeTable(Table::Course, "course", course),
+	makeTable(Table::Control, "control", control),
+	makeTable(Table::CourseControl, "course_control", courseControl),
+	makeTable(Table::Class, "class", class_)
+};
+static constexpr int tableCount = int(sizeof(tables) / sizeof(TableSchema));
+
+static constexpr bool isIndexedByTable()
+{
+	for (int i = 0; i < tableCount; ++i) {
+		if (tables[i].table != Table(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+static_assert(isIndexedByTable(), "Table schemas need to be in the same order as the Table enum");
+
+static constexpr bool fitsRecordSlots()
+{
+	for (int i = 0; i < tableCount; ++i) {
+		if (tables[i].fieldCount > 64) {
+			return false;
+		}
+	}
+	return true;
+}
+static_assert(fitsRecordSlots(), "Record keeps track of present values in a 64 bit mask");
+
+}
+
+int TableSchema::indexOf(const QString &field) const
+{
+	// tables only have a handful of fields, a linear search beats hashing the name
+	for (int i = 0; i < fieldCount; ++i) {
+		if (field == QLatin1String(fields[i].name)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+const TableSchema &tableSchema(const Table table)
+{
+	return detail::tables[int(table)];
+}
+const QVector<QString> &fieldNames(const Table table)
+{
+	static const QVector<QVector<QString>> names = []() {
+		QVector<QVector<QString>> result;
+		for (int i = 0; i < detail::tableCount; ++i) {
+			QVector<QString> fields;
+			for (const FieldSchema &field : detail::tables[i]) {
+				fields.append(intern(QString::fromLatin1(field.name)));
+			}
+			result.append(fields);
+		}
+		return result;
+	}();
+	return names.at(int(table));
+}
+QString sharedFieldName(const Table table, const QString &field)
+{
+	const int index = tableSchema(table).indexOf(field);
+	return index == -1 ? field : fieldNames(table).at(index);
+}
+QVariant internValue(const FieldSchema &field, const QVariant &value)
+{
+	return field.repetitive ? intern(value) : value;
+}
+const TableSchema *tableSchemasBegin()
+{
+	return detail::tables + 1;
+}
+const TableSchema *tableSchemasEnd()
+{
+	return detail::tables + detail::tableCount;
+}
+
+QString tableName(const Table table)
+{
+	if (table == Table::Null) {
+		throw SerializeNullTableNameException();
+	}
+	return QString::fromLatin1(tableSchema(table).name);
+}
+Table fromTableName(const QString &str)
+{
+	static const QHash<QString, Table> tables = []() {
+		QHash<QString, Table> result;
+		for (const TableSchema *schema = tableSchemasBegin(); schema != tableSchemasEnd(); ++schema) {
+			result.insert(QString::fromLatin1(schema->name), schema->table);
+		}
+		return result;
+	}();
+
+	const auto it = tables.constFind(str);
+	if (it == tables.constEnd()) {
+		throw InvalidTableNameException();
+	}
+	return it.value();
+}
+
+}
+}
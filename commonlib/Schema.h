@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "Record.h"
+#include "Validators.h"
+
+namespace Sportsed {
+namespace Common {
+
+struct FieldSchema
+{
+	const char *name;
+	BaseValidator::FieldType type;
+	/// Column definition following the field name, FK is replaced by the foreign key type of the database
+	const char *sql;
+	/// Whether the few distinct values of the field repeat over many records, see internValue()
+	bool repetitive = false;
+};
+
+/// Compile-time description of a table, the single source for table names, field types and the database schema
+struct TableSchema
+{
+	Table table;
+	const char *name;
+	const FieldSchema *fields;
+	int fieldCount;
+
+	constexpr const FieldSchema *begin() const { return fields; }
+	constexpr const FieldSchema *end() const { return fields + fieldCount; }
+	constexpr const FieldSchema &field(const int index) const { return fields[index]; }
+
+	/// Index of the given field, -1 for unknown fields and the implicit id field
+	int indexOf(const QString &field) const;
+};
+
+const TableSchema &tableSchema(const Table table);
+/// Names of the fields of the table in schema order, shared by all users instead of being allocated over and over
+const QVector<QString> &fieldNames(const Table table);
+/// The copy of the field name from fieldNames(), or the name as is for unknown fields
+QString sharedFieldName(const Table table, const QString &field);
+/// Interns the values of repetitive fields so that equal values share their storage, see Common::intern(). Values of
+/// other fields are mostly distinct and returned as is, to not fill the intern table with them
+QVariant internValue(const FieldSchema &field, const QVariant &value);
+/// Schemas of all tables except Table::Null, in the order of the Table enum
+const TableSchema *tableSchemasBegin();
+const TableSchema *tableSchemasEnd();
+
+}
+}
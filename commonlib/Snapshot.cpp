@@ -0,0 +1,86 @@
+#include "Snapshot.h"
+
+#include <jd-util/Json.h>
+
+#include <QJsonArray>
+
+using namespace JD::Util;
+
+namespace Sportsed {
+namespace Common {
+
+Snapshot::Snapshot() {}
+
+void Snapshot::add(const TableQuery &query, const QVector<Record> &records)
+{
+	m_queries.append(query);
+	m_results.append(records);
+}
+
+std::optional<QVector<Record>> Snapshot::records(const TableQuery &query) const
+{
+	const int index = m_queries.indexOf(query);
+	if (index == -1) {
+		return {};
+	}
+	return m_results.at(index);
+}
+QVector<Record> Snapshot::records(const Table table) const
+{
+	QVector<Record> records;
+	for (int i = 0; i < m_queries.size(); ++i) {
+		if (m_queries.at(i).table() == table) {
+			records += m_results.at(i);
+		}
+	}
+	return records;
+}
+
+std::optional<QVector<Record>> Snapshot::take(const TableQuery &query)
+{
+	const int index = m_queries.indexOf(query);
+	if (index == -1) {
+		return {};
+	}
+	m_queries.remove(index);
+	return m_results.takeAt(index);
+}
+QVector<Record> Snapshot::take(const Table table)
+{
+	QVector<Record> records;
+	for (int i = m_queries.size() - 1; i >= 0; --i) {
+		if (m_queries.at(i).table() == table) {
+			m_queries.remove(i);
+			records = m_results.takeAt(i) + records;
+		}
+	}
+	return records;
+}
+
+Snapshot Snapshot::fromJson(const QJsonObject &obj)
+{
+	Snapshot snapshot;
+	snapshot.m_revision = Json::ensureIsType<Revision>(obj, "revision");
+	for (const QJsonValue &result : ensureArray(obj, "results")) {
+		const QJsonObject resultObj = Json::ensureObject(result);
+		snapshot.add(Json::ensureIsType<TableQuery>(resultObj, "query"), Json::ensureIsArrayOf<Record>(resultObj, "records"));
+	}
+	return snapshot;
+}
+QJsonObject Snapshot::toJson() const
+{
+	QJsonArray results;
+	for (int i = 0; i < m_queries.size(); ++i) {
+		results.append(QJsonObject({
+									   {"query", m_queries.at(i).toJson()},
+									   {"records", Json::toJsonArray(m_results.at(i))}
+								   }));
+	}
+	return QJsonObject({
+						   {"revision", Json::toJson(m_revision)},
+						   {"results", results}
+					   });
+}
+
+}
+}
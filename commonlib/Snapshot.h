@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QVector>
+#include <utility>
+
+#include "TableQuery.h"
+#include "Record.h"
+
+namespace Sportsed {
+namespace Common {
+
+/// The results of several queries, all taken at the same revision
+class Snapshot
+{
+public:
+	explicit Snapshot();
+
+	bool isEmpty() const { return m_queries.isEmpty(); }
+
+	/// Changes after this revision are not reflected in the results
+	Revision revision() const { return m_revision; }
+	void setRevision(const Revision revision) { m_revision = revision; }
+
+	const QVector<TableQuery> &queries() const { return m_queries; }
+	void add(const TableQuery &query, const QVector<Record> &records);
+
+	/// The records found by the given query, nothing if the query is not part of the snapshot
+	std::optional<QVector<Record>> records(const TableQuery &query) const;
+	/// All records of the given table found by any of the queries
+	QVector<Record> records(const Table table) const;
+	/// Like records(), but removes the results from the snapshot, for results that are only used once
+	std::optional<QVector<Record>> take(const TableQuery &query);
+	QVector<Record> take(const Table table);
+
+	static Snapshot fromJson(const QJsonObject &obj);
+	QJsonObject toJson() const;
+
+private:
+	Revision m_revision = 0;
+	QVector<TableQuery> m_queries;
+	QVector<QVector<Record>> m_results;
+};
+
+}
+}
+
+Q_DECLARE_METATYPE(Sportsed::Common::Snapshot)
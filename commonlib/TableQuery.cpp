@@ -2,7 +2,11 @@
 
 #include <jd-util/Json.h>
 
+#include "Validators.h"
+#include "QueryPredicate.h"
+
 #include <QDebug>
+#include <QJsonArray>
 
 using namespace JD::Util;
 
@@ -16,24 +20,66 @@ TableFilter::TableFilter(const QString &field, const QVariant &value)
 TableFilter::TableFilter(const QString &field, const TableFilter::Operator op, const QVariant &value)
 	: m_field(field), m_op(op), m_value(value) {}
 
+TableFilter TableFilter::allOf(const QVector<TableFilter> &filters)
+{
+	TableFilter filter;
+	filter.m_op = And;
+	filter.m_children = filters;
+	return filter;
+}
+TableFilter TableFilter::anyOf(const QVector<TableFilter> &filters)
+{
+	TableFilter filter;
+	filter.m_op = Or;
+	filter.m_children = filters;
+	return filter;
+}
+TableFilter TableFilter::negated(const TableFilter &filter)
+{
+	TableFilter negation;
+	negation.m_op = Not;
+	negation.m_children = {filter};
+	return negation;
+}
+
 static const Json::Enum<TableFilter::Operator> operatorEnum = {
 	{TableFilter::Equal, "="},
 	{TableFilter::NotEqual, "!="},
 	{TableFilter::Less, "<"},
 	{TableFilter::LessEqual, "<="},
 	{TableFilter::Greater, ">"},
-	{TableFilter::GreaterEqual, ">="}
+	{TableFilter::GreaterEqual, ">="},
+	{TableFilter::In, "in"},
+	{TableFilter::Between, "between"},
+	{TableFilter::StartsWith, "starts_with"},
+	{TableFilter::IsNull, "is_null"},
+	{TableFilter::And, "and"},
+	{TableFilter::Or, "or"},
+	{TableFilter::Not, "not"}
 };
 TableFilter TableFilter::fromJson(const QJsonObject &obj)
 {
 	TableFilter filter;
-	filter.m_field = Json::ensureString(obj, "field");
 	filter.m_op = operatorEnum.ensure(obj, "op");
-	filter.m_value = Json::ensureVariant(obj, "value");
+	if (filter.isGroup()) {
+		filter.m_children = Json::ensureIsArrayOf<TableFilter>(obj, "filters");
+		if (filter.m_op == Not && filter.m_children.size() != 1) {
+			throw Exception("Negations need exactly one filter");
+		}
+	} else {
+		filter.m_field = Json::ensureString(obj, "field");
+		filter.m_value = Json::ensureVariant(obj, "value");
+	}
 	return filter;
 }
 QJsonObject TableFilter::toJson() const
 {
+	if (isGroup()) {
+		return QJsonObject({
+							   {"op", operatorEnum.toJson(m_op)},
+							   {"filters", Json::toJsonArray(m_children)}
+						   });
+	}
 	return QJsonObject({
 						   {"field", m_field},
 						   {"op", operatorEnum.toJson(m_op)},
@@ -41,9 +87,81 @@ QJsonObject TableFilter::toJson() const
 					   });
 }
 
+bool TableFilter::matches(const QVariant &value) const
+{
+	if (m_op == IsNull) {
+		return value.isNull() == m_value.toBool();
+	} else if (value.isNull()) {
+		// comparisons with NULL never match, same as in SQL
+		return false;
+	}
+
+	switch (m_op) {
+	case Equal: return value == m_value;
+	case NotEqual: return value != m_value;
+	case Less: return value < m_value;
+	case LessEqual: return value <= m_value;
+	case Greater: return value > m_value;
+	case GreaterEqual: return value >= m_value;
+	case In: return m_value.toList().contains(value);
+	case Between: {
+		const QVariantList bounds = m_value.toList();
+		return bounds.size() == 2 && bounds.at(0) <= value && value <= bounds.at(1);
+	}
+	case StartsWith: return value.toString().startsWith(m_value.toString());
+	case IsNull: return false; // handled above
+	case And:
+	case Or:
+	case Not:
+		return false;
+	}
+}
+
+bool TableFilter::matches(const Record &record) const
+{
+	return QueryPredicate(TableQuery(record.table(), *this)).matches(record);
+}
+
 bool TableFilter::operator==(const TableFilter &other) const
 {
-	return m_field == other.m_field && m_op == other.m_op && m_value == other.m_value;
+	return m_field == other.m_field && m_op == other.m_op && m_value == other.m_value && m_children == other.m_children;
+}
+
+TableSort::TableSort() {}
+
+TableSort::TableSort(const QString &field, const bool descending)
+	: m_field(field), m_descending(descending) {}
+
+static const Json::Enum<bool> orderEnum = {
+	{false, "asc"},
+	{true, "desc"}
+};
+TableSort TableSort::fromJson(const QJsonObject &obj)
+{
+	TableSort sort;
+	sort.m_field = Json::ensureString(obj, "field");
+	sort.m_descending = orderEnum.ensure(obj, "order");
+	return sort;
+}
+QJsonObject TableSort::toJson() const
+{
+	return QJsonObject({
+						   {"field", m_field},
+						   {"order", orderEnum.toJson(m_descending)}
+					   });
+}
+
+int TableSort::compare(const QVariant &a, const QVariant &b)
+{
+	if (a.isNull() || b.isNull()) {
+		return int(b.isNull()) - int(a.isNull());
+	}
+	return a < b ? -1 : b < a ? 1 : 0;
+}
+
+bool TableSort::operator==(const TableSort &other) const
+{
+	return m_field == other.m_field && m_descending == other.m_descending;
 }
 
 TableQuery::TableQuery() {}
@@ -59,33 +177,205 @@ TableQuery TableQuery::fromJson(const QJsonObject &obj)
 	TableQuery query;
 	query.m_table = Common::fromTableName(Json::ensureString(obj, "table"));
 	query.m_filters = Json::ensureIsArrayOf<TableFilter>(obj, "filters");
+	if (obj.contains("fields")) {
+		query.m_fields = Json::ensureIsArrayOf<QString>(obj, "fields");
+	}
+	if (obj.contains("sort")) {
+		query.m_sort = Json::ensureIsArrayOf<TableSort>(obj, "sort");
+	}
+	if (obj.contains("limit")) {
+		query.m_limit = Json::ensureInteger(obj, "limit");
+	}
+	if (obj.contains("include")) {
+		query.m_includes = Json::ensureIsArrayOf<QString>(obj, "include");
+	}
+	if (obj.contains("after")) {
+		// JSON loses types like dates and ids, the values need to compare equal to the ones in records again
+		BaseValidator *validator = BaseValidator::getValidator(query.m_table);
+		const QJsonArray values = ensureArray(obj, "after");
+		for (int i = 0; i < values.size(); ++i) {
+			QVariant value = values.at(i).toVariant();
+			if (values.at(i).isNull()) {
+				value = QVariant(); // sorts first, see TableSort::compare()
+			} else if (i >= query.m_sort.size() || query.m_sort.at(i).field() == "id") {
+				value = QVariant::fromValue(value.value<Id>());
+			} else if (validator) {
+				try {
+					value = validator->coerce(query.m_sort.at(i).field(), value);
+				} catch (CoercionException &) {
+					// compared as is
+				}
+			}
+			query.m_after.append(value);
+		}
+	}
 	return query;
 }
 QJsonObject TableQuery::toJson() const
+{
+	QJsonObject obj({
+						{"table", Common::tableName(m_table)},
+						{"filters", Json::toJsonArray(m_filters)}
+					});
+	if (!m_fields.isEmpty()) {
+		obj.insert("fields", Json::toJsonArray(m_fields));
+	}
+	if (!m_sort.isEmpty()) {
+		obj.insert("sort", Json::toJsonArray(m_sort));
+	}
+	if (m_limit != 0) {
+		obj.insert("limit", m_limit);
+	}
+	if (!m_includes.isEmpty()) {
+		obj.insert("include", Json::toJsonArray(m_includes));
+	}
+	if (!m_after.isEmpty()) {
+		QJsonArray after;
+		for (const QVariant &value : m_after) {
+			after.append(Json::toJson(value));
+		}
+		obj.insert("after", after);
+	}
+	return obj;
+}
+
+void TableQuery::setAfter(const Record &record)
+{
+	m_after.clear();
+	for (const TableSort &sort : m_sort) {
+		m_after.append(record.value(sort.field()));
+	}
+	m_after.append(QVariant::fromValue(record.id()));
+}
+
+static QVariant sortValue(const Record &record, const QString &field)
+{
+	return field == "id" ? QVariant::fromValue(record.id()) : record.value(field);
+}
+bool TableQuery::lessThan(const Record &a, const Record &b) const
+{
+	for (const TableSort &sort : m_sort) {
+		const int comparison = sort.compareValues(sortValue(a, sort.field()), sortValue(b, sort.field()));
+		if (comparison != 0) {
+			return comparison < 0;
+		}
+	}
+	return a.id() < b.id();
+}
+bool TableQuery::isAfterCursor(const Record &record) const
+{
+	if (m_after.isEmpty()) {
+		return true;
+	}
+	for (int i = 0; i < m_sort.size() && i < m_after.size(); ++i) {
+		const int comparison = m_sort.at(i).compareValues(sortValue(record, m_sort.at(i).field()), m_after.at(i));
+		if (comparison != 0) {
+			return comparison > 0;
+		}
+	}
+	return m_after.size() > m_sort.size() && m_after.at(m_sort.size()).value<Id>() < record.id();
+}
+
+bool TableQuery::operator==(const TableQuery &other) const
+{
+	return m_table == other.m_table && m_filters == other.m_filters && m_fields == other.m_fields
+			&& m_sort == other.m_sort && m_limit == other.m_limit && m_after == other.m_after
+			&& m_includes == other.m_includes;
+}
+
+FindResult::FindResult(const QVector<Record> &records, const QVector<Record> &included)
+	: m_records(records), m_included(included) {}
+
+Record FindResult::included(const Table table, const Id id) const
+{
+	for (const Record &record : m_included) {
+		if (record.table() == table && record.id() == id) {
+			return record;
+		}
+	}
+	return Record();
+}
+
+FindResult FindResult::fromJson(const QJsonObject &obj)
+{
+	return FindResult(Json::ensureIsArrayOf<Record>(obj, "records"), Json::ensureIsArrayOf<Record>(obj, "included"));
+}
+QJsonObject FindResult::toJson() const
 {
 	return QJsonObject({
-						   {"table", Common::tableName(m_table)},
-						   {"filters", Json::toJsonArray(m_filters)}
+						   {"records", Json::toJsonArray(m_records)},
+						   {"included", Json::toJsonArray(m_included)}
 					   });
 }
 
-bool TableQuery::operator==(const TableQuery &other) const
+RecordBatch::RecordBatch(const QVector<Record> &records)
+	: m_records(records) {}
+
+RecordBatch RecordBatch::fromJson(const QJsonObject &obj)
+{
+	RecordBatch batch;
+	for (const QJsonValue &record : ensureArray(obj, "records")) {
+		batch.m_records.append(record.isNull() ? Record() : Json::ensureIsType<Record>(record));
+	}
+	return batch;
+}
+QJsonObject RecordBatch::toJson() const
+{
+	QJsonArray records;
+	for (const Record &record : m_records) {
+		records.append(record.isNull() ? QJsonValue() : QJsonValue(record.toJson()));
+	}
+	return QJsonObject({{"records", records}});
+}
+
+ConditionalResult::ConditionalResult(const Revision revision)
+	: m_revision(revision) {}
+ConditionalResult::ConditionalResult(const Revision revision, const QVector<Record> &records)
+	: m_modified(true), m_revision(revision), m_records(records) {}
+
+ConditionalResult ConditionalResult::fromJson(const QJsonObject &obj)
+{
+	const Revision revision = Json::ensureIsType<Revision>(obj, "revision");
+	if (obj.value("not_modified").toBool()) {
+		return ConditionalResult(revision);
+	}
+	return ConditionalResult(revision, Json::ensureIsArrayOf<Record>(obj, "records"));
+}
+QJsonObject ConditionalResult::toJson() const
 {
-	return m_table == other.m_table && m_filters == other.m_filters;
+	if (!m_modified) {
+		return QJsonObject({
+							   {"not_modified", true},
+							   {"revision", Json::toJson(m_revision)}
+						   });
+	}
+	return QJsonObject({
+						   {"revision", Json::toJson(m_revision)},
+						   {"records", Json::toJsonArray(m_records)}
+					   });
 }
 
 }
 }
 
+static QString filterToString(const Sportsed::Common::TableFilter &f)
+{
+	if (f.isGroup()) {
+		return Sportsed::Common::operatorEnum.toJson(f.op()).toString() + '(' + Functional::collection(f.children()).map([](const Sportsed::Common::TableFilter &child) {
+			return filterToString(child);
+		}).join(QStringLiteral(", ")) + ')';
+	}
+	QString val;
+	if (f.value().type() == QVariant::String) {
+		val = '"' + f.value().toString() + '"';
+	} else {
+		val = f.value().toString();
+	}
+	return f.field() + Sportsed::Common::operatorEnum.toJson(f.op()).toString() + val;
+}
 QDebug &operator<<(QDebug &dbg, const QVector<Sportsed::Common::TableFilter> &filters)
 {
 	return dbg << qPrintable('(' + Functional::collection(filters).map([](const Sportsed::Common::TableFilter &f) {
-		QString val;
-		if (f.value().type() == QVariant::String) {
-			val = '"' + f.value().toString() + '"';
-		} else {
-			val = f.value().toString();
-		}
-		return f.field() + Sportsed::Common::operatorEnum.toJson(f.op()).toString() + val;
+		return filterToString(f);
 	}).join(QStringLiteral(", ")) + ')');
 }
@@ -2,6 +2,7 @@
 
 #include <QVariant>
 #include <QVector>
+#include <utility>
 
 #include "Record.h"
 
@@ -18,22 +19,42 @@ public:
 		Less,
 		LessEqual,
 		Greater,
-		GreaterEqual
+		GreaterEqual,
+		In, ///< value is a list of values
+		Between, ///< value is a list of the lower and upper bound, both inclusive
+		StartsWith, ///< value is a string prefix
+		IsNull, ///< value is true to find NULL values, false for non-NULL ones
+		And, ///< matches if all children match, field and value are unused
+		Or, ///< matches if any child matches, field and value are unused
+		Not ///< matches if the only child does not match, field and value are unused
 	};
 
 	explicit TableFilter();
 	explicit TableFilter(const QString &field, const QVariant &value);
 	explicit TableFilter(const QString &field, const Operator op, const QVariant &value);
 
-	QString field() const { return m_field; }
+	static TableFilter allOf(const QVector<TableFilter> &filters);
+	static TableFilter anyOf(const QVector<TableFilter> &filters);
+	static TableFilter negated(const TableFilter &filter);
+
+	const QString &field() const { return m_field; }
 	void setField(const QString &field) { m_field = field; }
 
 	Operator op() const { return m_op; }
 	void setOp(const Operator op) { m_op = op; }
 
-	QVariant value() const { return m_value; }
+	const QVariant &value() const { return m_value; }
 	void setValue(const QVariant &value) { m_value = value; }
 
+	bool isGroup() const { return m_op == And || m_op == Or || m_op == Not; }
+	const QVector<TableFilter> &children() const { return m_children; }
+	void setChildren(const QVector<TableFilter> &children) { m_children = children; }
+
+	/// Whether the given value of the field passes this filter, which may not be a group
+	bool matches(const QVariant &value) const;
+	/// Whether the record may match this filter, filters on fields of referenced records are assumed to match
+	bool matches(const Record &record) const;
+
 	static TableFilter fromJson(const QJsonObject &obj);
 	QJsonObject toJson() const;
 
@@ -43,6 +64,35 @@ private:
 	QString m_field;
 	Operator m_op = Equal;
 	QVariant m_value;
+	QVector<TableFilter> m_children;
+};
+
+class TableSort
+{
+public:
+	explicit TableSort();
+	explicit TableSort(const QString &field, const bool descending = false);
+
+	const QString &field() const { return m_field; }
+	void setField(const QString &field) { m_field = field; }
+
+	bool isDescending() const { return m_descending; }
+	void setDescending(const bool descending) { m_descending = descending; }
+
+	/// Compares the values the way the database sorts them in ascending order, NULL comes before all other values.
+	/// Returns a negative number if a comes first, a positive one if b does and 0 if they are equal
+	static int compare(const QVariant &a, const QVariant &b);
+	/// Like compare(), but in the direction of this key
+	int compareValues(const QVariant &a, const QVariant &b) const { return m_descending ? compare(b, a) : compare(a, b); }
+
+	static TableSort fromJson(const QJsonObject &obj);
+	QJsonObject toJson() const;
+
+	bool operator==(const TableSort &other) const;
+
+private:
+	QString m_field;
+	bool m_descending = false;
 };
 
 class TableQuery
@@ -57,8 +107,39 @@ public:
 	Table table() const { return m_table; }
 	void setTable(const Table &table) { m_table = table; }
 
-	QVector<TableFilter> filters() const { return m_filters; }
+	const QVector<TableFilter> &filters() const { return m_filters; }
 	void setFilters(const QVector<TableFilter> &filters) { m_filters = filters; }
+	void setFilters(QVector<TableFilter> &&filters) { m_filters = std::move(filters); }
+
+	/// Fields to include in the found records, all fields if empty. Records are incomplete if fields are given
+	const QVector<QString> &fields() const { return m_fields; }
+	void setFields(const QVector<QString> &fields) { m_fields = fields; }
+	bool isProjected() const { return !m_fields.isEmpty(); }
+
+	/// Results are ordered by the sort keys and then by id, records are ordered by id if no sort keys are given
+	const QVector<TableSort> &sort() const { return m_sort; }
+	void setSort(const QVector<TableSort> &sort) { m_sort = sort; }
+
+	/// Maximum number of records to return, 0 for no limit. Subscriptions do not apply the limit, since whether a
+	/// change affects the first records depends on all the others
+	int limit() const { return m_limit; }
+	void setLimit(const int limit) { m_limit = limit; }
+
+	/// Foreign key paths like "course_id" or "course_id>stage_id" whose referenced records are returned along with the
+	/// found ones, see FindResult. Only used by plain finds, not by streamed finds and subscriptions
+	const QVector<QString> &includes() const { return m_includes; }
+	void setIncludes(const QVector<QString> &includes) { m_includes = includes; }
+
+	/// Keyset cursor: only records ordered after the one with these sort key values followed by its id are returned
+	const QVector<QVariant> &after() const { return m_after; }
+	void setAfter(const QVector<QVariant> &after) { m_after = after; }
+	/// Continues after the given record, which needs to contain the sort key fields, usually the last one of a page
+	void setAfter(const Record &record);
+
+	/// Whether a is ordered before b according to the sort keys
+	bool lessThan(const Record &a, const Record &b) const;
+	/// Whether the record comes after the cursor, always true if there is no cursor
+	bool isAfterCursor(const Record &record) const;
 
 	static TableQuery fromJson(const QJsonObject &obj);
 	QJsonObject toJson() const;
@@ -68,6 +149,69 @@ public:
 private:
 	Table m_table;
 	QVector<TableFilter> m_filters;
+	QVector<QString> m_fields;
+	QVector<TableSort> m_sort;
+	int m_limit = 0;
+	QVector<QVariant> m_after;
+	QVector<QString> m_includes;
+};
+
+/// Records found by a query together with the records referenced through its includes
+class FindResult
+{
+public:
+	explicit FindResult(const QVector<Record> &records = {}, const QVector<Record> &included = {});
+
+	const QVector<Record> &records() const { return m_records; }
+	/// Each referenced record once, regardless of how many records or includes reference it
+	const QVector<Record> &included() const { return m_included; }
+
+	/// The included record with the given table and id, a record of Table::Null if it has not been included
+	Record included(const Table table, const Id id) const;
+
+	static FindResult fromJson(const QJsonObject &obj);
+	QJsonObject toJson() const;
+
+private:
+	QVector<Record> m_records;
+	QVector<Record> m_included;
+};
+
+/// Records read by id in the order they have been requested, null records take the place of the ones that do not exist
+class RecordBatch
+{
+public:
+	explicit RecordBatch(const QVector<Record> &records = {});
+
+	const QVector<Record> &records() const { return m_records; }
+
+	static RecordBatch fromJson(const QJsonObject &obj);
+	QJsonObject toJson() const;
+
+private:
+	QVector<Record> m_records;
+};
+
+/// Reply to a find or read that only returns records if something has changed since the revision the client has them at
+class ConditionalResult
+{
+public:
+	explicit ConditionalResult(const Revision revision = 0);
+	explicit ConditionalResult(const Revision revision, const QVector<Record> &records);
+
+	bool isModified() const { return m_modified; }
+	/// The records are current as of this revision, and so are the ones of the client if nothing has been modified
+	Revision revision() const { return m_revision; }
+	/// The found records or the read record, empty if nothing has been modified
+	const QVector<Record> &records() const { return m_records; }
+
+	static ConditionalResult fromJson(const QJsonObject &obj);
+	QJsonObject toJson() const;
+
+private:
+	bool m_modified = false;
+	Revision m_revision;
+	QVector<Record> m_records;
 };
 
 }
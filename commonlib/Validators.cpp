@@ -1,85 +1,31 @@
 #include "Validators.h"
 
 #include <QHostAddress>
+#include <QJsonDocument>
 
 #include <jd-util/Formatting.h>
 #include <cmath>
 
 #include "Record.h"
+#include "Schema.h"
 
 namespace Sportsed {
 namespace Common {
 
 namespace detail {
 
-QT_WARNING_PUSH
-QT_WARNING_DISABLE_CLANG("-Wglobal-constructors")
-using Fields = QHash<QString, BaseValidator::FieldType>;
-static Fields meta = {
-	{"key", BaseValidator::String},
-	{"value", BaseValidator::String}
-};
-static Fields change = {
-	{"type", BaseValidator::Char},
-	{"record_id", BaseValidator::ID},
-	{"record_table", BaseValidator::String},
-	{"timestamp", BaseValidator::Integer},
-	{"fields", BaseValidator::String}
-};
-static Fields profile = {
-	{"type", BaseValidator::String},
-	{"name", BaseValidator::String},
-	{"value", BaseValidator::JSON}
-};
-static Fields client = {
-	{"name", BaseValidator::String},
-	{"ip", BaseValidator::IP}
-};
-static Fields competition = {
-	{"name", BaseValidator::String},
-	{"sport", BaseValidator::String}
-};
-static Fields stage = {
-	{"competition_id", BaseValidator::ID},
-	{"name", BaseValidator::String},
-	{"type", BaseValidator::String},
-	{"discipline", BaseValidator::String},
-	{"date", BaseValidator::Date},
-	{"in_totals", BaseValidator::Boolean},
-};
-static Fields control = {
-	{"stage_id", BaseValidator::ID},
-	{"name", BaseValidator::String},
-	{"special", BaseValidator::String}
-};
-static Fields course = {
-	{"stage_id", BaseValidator::ID},
-	{"name", BaseValidator::String}
-};
-static Fields courseControl = {
-	{"control_id", BaseValidator::ID},
-	{"course_id", BaseValidator::ID},
-	{"order", BaseValidator::Integer},
-	{"distance_from_previous", BaseValidator::Real}
-};
-static Fields class_ = {
-	{"stage_id", BaseValidator::ID},
-	{"name", BaseValidator::String}
+class SchemaValidator : public BaseValidator
+{
+public:
+	explicit SchemaValidator(const Table table)
+		: m_schema(tableSchema(table)) {}
+
+protected:
+	const TableSchema &schema() const override { return m_schema; }
+
+private:
+	const TableSchema &m_schema;
 };
-QT_WARNING_POP
-
-#define MAKE_VALIDATOR(name, global) class name ## Validator : public BaseValidator { QHash<QString, FieldType> fields() const override { return global; } };
-MAKE_VALIDATOR(Meta, meta)
-MAKE_VALIDATOR(Change, change)
-MAKE_VALIDATOR(Profile, profile)
-MAKE_VALIDATOR(Client, client)
-MAKE_VALIDATOR(Competition, competition)
-MAKE_VALIDATOR(Stage, stage)
-MAKE_VALIDATOR(Control, control)
-MAKE_VALIDATOR(Course, course)
-MAKE_VALIDATOR(CourseControl, courseControl)
-MAKE_VALIDATOR(Class, class_)
-#undef MAKE_VALIDATOR
 
 inline bool isInteger(const QVariant &value) {
 	const QVariant::Type type = value.type();
@@ -98,12 +44,7 @@ BaseValidator::~BaseValidator() {}
 
 void BaseValidator::validateField(const QString &field, const QVariant &value)
 {
-	if (!fields().contains(field)) {
-		throw UnknownFieldException();
-	}
-
-	const FieldType type = fields().value(field);
-	switch (type) {
+	switch (fieldType(fieldIndex(field))) {
 	case Sportsed::Common::BaseValidator::ID: [[clang::fallthrough]];
 	case Sportsed::Common::BaseValidator::Integer:
 		if (!detail::isInteger(value)) {
@@ -156,7 +97,8 @@ void BaseValidator::validateField(const QString &field, const QVariant &value)
 		}
 		break;
 	case Sportsed::Common::BaseValidator::JSON:
-		if (value.type() != qMetaTypeId<QJsonObject>()) {
+		// kept as the text stored in the database
+		if (value.type() != QVariant::String || QJsonDocument::fromJson(value.toString().toUtf8()).isNull()) {
 			throw ValidationException("Not JSON");
 		}
 		break;
@@ -165,27 +107,32 @@ void BaseValidator::validateField(const QString &field, const QVariant &value)
 
 void BaseValidator::validateRecord(const Record &record)
 {
-	for (const QString &field : fields().keys()) {
-		if (!record.values().contains(field)) {
-			throw MissingRequiredFieldException("Missing required field '%1'" % field);
+	for (int i = 0; i < schema().fieldCount; ++i) {
+		if (!record.hasValue(i)) {
+			throw MissingRequiredFieldException("Missing required field '%1'" % QString(schema().field(i).name));
 		}
 	}
 
-	for (auto it = record.values().cbegin(); it != record.values().cend(); ++it) {
-		validateField(it.key(), it.value());
+	for (const QString &field : record.fields()) {
+		validateField(field, record.value(field));
 	}
 }
 
 QVariant BaseValidator::coerce(const QString &field, const QVariant &value)
 {
-	if (!fields().contains(field)) {
-		throw UnknownFieldException();
+	return coerce(fieldIndex(field), value);
+}
+QVariant BaseValidator::coerce(const int fieldIndex, const QVariant &value)
+{
+	const int type = metaType(fieldIndex);
+	if (value.userType() == type) {
+		return value;
 	}
 	QVariant res(value);
-	if (!res.convert(metaType(field))) {
+	if (!res.convert(type)) {
 		throw CoercionException(QStringLiteral("Unable to convert from %1 to %2")
 								% value.typeName()
-								% QMetaType::typeName(metaType(field)));
+								% QMetaType::typeName(type));
 	}
 	return res;
 }
@@ -195,7 +142,7 @@ Record BaseValidator::coerceRecord(const Record &record)
 	Record out(record.table());
 	out.setId(record.id());
 	out.setLatestRevision(record.latestRevision());
-	for (const QString &field : record.values().keys()) {
+	for (const QString &field : record.fields()) {
 		out.setValue(field, coerce(field, record.value(field)));
 	}
 	return out;
@@ -203,27 +150,31 @@ Record BaseValidator::coerceRecord(const Record &record)
 
 BaseValidator *BaseValidator::getValidator(const Table &table)
 {
+	if (table == Table::Null) {
+		return nullptr;
+	}
 	if (!detail::validators->contains(table)) {
-		switch (table) {
-		case Table::Null: return nullptr;
-		case Table::Meta: detail::validators->insert(table, new detail::MetaValidator); break;
-		case Table::Change: detail::validators->insert(table, new detail::ChangeValidator); break;
-		case Table::Profile: detail::validators->insert(table, new detail::ProfileValidator); break;
-		case Table::Client: detail::validators->insert(table, new detail::ClientValidator); break;
-		case Table::Competition: detail::validators->insert(table, new detail::CompetitionValidator); break;
-		case Table::Stage: detail::validators->insert(table, new detail::StageValidator); break;
-		case Table::Control: detail::validators->insert(table, new detail::ControlValidator); break;
-		case Table::Course: detail::validators->insert(table, new detail::CourseValidator); break;
-		case Table::CourseControl: detail::validators->insert(table, new detail::CourseControlValidator); break;
-		case Table::Class: detail::validators->insert(table, new detail::ClassValidator); break;
-		}
+		detail::validators->insert(table, new detail::SchemaValidator(table));
 	}
 	return detail::validators->value(table);
 }
 
-int BaseValidator::metaType(const QString &field) const
+BaseValidator::FieldType BaseValidator::fieldType(const int fieldIndex) const
+{
+	return schema().field(fieldIndex).type;
+}
+
+int BaseValidator::fieldIndex(const QString &field) const
+{
+	const int index = schema().indexOf(field);
+	if (index == -1) {
+		throw UnknownFieldException();
+	}
+	return index;
+}
+int BaseValidator::metaType(const int fieldIndex) const
 {
-	switch (fields().value(field)) {
+	switch (fieldType(fieldIndex)) {
 	case Sportsed::Common::BaseValidator::ID: return qMetaTypeId<Common::Id>();
 	case Sportsed::Common::BaseValidator::Char: return QMetaType::QChar;
 	case Sportsed::Common::BaseValidator::String: return QMetaType::QString;
@@ -234,7 +185,7 @@ int BaseValidator::metaType(const QString &field) const
 	case Sportsed::Common::BaseValidator::Time: return QMetaType::QTime;
 	case Sportsed::Common::BaseValidator::DateTime: return QMetaType::QDateTime;
 	case Sportsed::Common::BaseValidator::IP: return QMetaType::QString;
-	case Sportsed::Common::BaseValidator::JSON: return QMetaType::QJsonDocument;
+	case Sportsed::Common::BaseValidator::JSON: return QMetaType::QString;
 	}
 }
 
@@ -8,6 +8,7 @@ namespace Sportsed {
 namespace Common {
 class Record;
 enum class Table;
+struct TableSchema;
 
 DECLARE_EXCEPTION(Validation)
 DECLARE_EXCEPTION_X(MissingRequiredField, "Missing required field", ValidationException)
@@ -23,6 +24,8 @@ public:
 	virtual void validateRecord(const Record &record);
 
 	virtual QVariant coerce(const QString &field, const QVariant &value);
+	/// Like coerce(), for the field at the given index of the table schema, which spares looking up the field by name
+	virtual QVariant coerce(const int fieldIndex, const QVariant &value);
 	virtual Record coerceRecord(const Record &record);
 
 	static BaseValidator *getValidator(const Table &table);
@@ -42,10 +45,14 @@ public:
 		JSON
 	};
 
+	FieldType fieldType(const int fieldIndex) const;
+
 protected:
-	virtual QHash<QString, FieldType> fields() const = 0;
+	virtual const TableSchema &schema() const = 0;
 
-	int metaType(const QString &field) const;
+	/// Index of the field in the schema, throws an UnknownFieldException for unknown fields
+	int fieldIndex(const QString &field) const;
+	int metaType(const int fieldIndex) const;
 };
 
 }
@@ -0,0 +1,485 @@
+#include "ColumnStore.h"
+
+#include <QDate>
+#include <QTime>
+#include <QDateTime>
+#include <QtAlgorithms>
+#include <algorithm>
+#include <functional>
+
+namespace Sportsed {
+namespace Server {
+
+static inline bool testBit(const QVector<quint64> &bitmap, const int index)
+{
+	return bitmap.at(index / 64) & (quint64(1) << (index % 64));
+}
+static inline void setBit(QVector<quint64> &bitmap, const int index, const bool value)
+{
+	if (value) {
+		bitmap[index / 64] |= quint64(1) << (index % 64);
+	} else {
+		bitmap[index / 64] &= ~(quint64(1) << (index % 64));
+	}
+}
+static inline void intersect(QVector<quint64> &selection, const QVector<quint64> &other)
+{
+	for (int i = 0; i < selection.size(); ++i) {
+		selection[i] &= other.at(i);
+	}
+}
+static inline void unite(QVector<quint64> &selection, const QVector<quint64> &other)
+{
+	for (int i = 0; i < selection.size(); ++i) {
+		selection[i] |= other.at(i);
+	}
+}
+
+/// Compares 64 values at a time into one word of the selection, without any branches in the inner loop
+template <typename T, typename Compare>
+static void scanColumn(const T *values, const int size, const T value, const Compare compare, quint64 *selection)
+{
+	for (int word = 0, offset = 0; offset < size; ++word, offset += 64) {
+		const int count = std::min(64, size - offset);
+		quint64 bits = 0;
+		for (int i = 0; i < count; ++i) {
+			bits |= quint64(compare(values[offset + i], value)) << i;
+		}
+		selection[word] &= bits;
+	}
+}
+template <typename T>
+static void scanColumn(const QVector<T> &values, const Common::TableFilter::Operator op, const T value, QVector<quint64> &selection)
+{
+	switch (op) {
+	case Common::TableFilter::Equal: scanColumn(values.constData(), values.size(), value, std::equal_to<T>(), selection.data()); break;
+	case Common::TableFilter::NotEqual: scanColumn(values.constData(), values.size(), value, std::not_equal_to<T>(), selection.data()); break;
+	case Common::TableFilter::Less: scanColumn(values.constData(), values.size(), value, std::less<T>(), selection.data()); break;
+	case Common::TableFilter::LessEqual: scanColumn(values.constData(), values.size(), value, std::less_equal<T>(), selection.data()); break;
+	case Common::TableFilter::Greater: scanColumn(values.constData(), values.size(), value, std::greater<T>(), selection.data()); break;
+	case Common::TableFilter::GreaterEqual: scanColumn(values.constData(), values.size(), value, std::greater_equal<T>(), selection.data()); break;
+	case Common::TableFilter::In:
+	case Common::TableFilter::Between:
+	case Common::TableFilter::StartsWith:
+	case Common::TableFilter::IsNull:
+	case Common::TableFilter::And:
+	case Common::TableFilter::Or:
+	case Common::TableFilter::Not:
+		Q_UNREACHABLE(); // rejected by ColumnStore::scan
+	}
+}
+
+static bool compareStrings(const QString &a, const Common::TableFilter::Operator op, const QString &b)
+{
+	switch (op) {
+	case Common::TableFilter::Equal: return a == b;
+	case Common::TableFilter::NotEqual: return a != b;
+	case Common::TableFilter::Less: return a < b;
+	case Common::TableFilter::LessEqual: return a <= b;
+	case Common::TableFilter::Greater: return a > b;
+	case Common::TableFilter::GreaterEqual: return a >= b;
+	case Common::TableFilter::In:
+	case Common::TableFilter::Between:
+	case Common::TableFilter::StartsWith:
+	case Common::TableFilter::IsNull:
+	case Common::TableFilter::And:
+	case Common::TableFilter::Or:
+	case Common::TableFilter::Not:
+		Q_UNREACHABLE(); // rejected by ColumnStore::scan
+	}
+}
+
+/// Maps values of integer-like fields to the int64 used for storage, returns false if the value is not representable
+static bool toInteger(const Common::BaseValidator::FieldType type, const QVariant &value, qint64 &out)
+{
+	switch (type) {
+	case Common::BaseValidator::ID: out = qint64(value.toULongLong()); return true;
+	case Common::BaseValidator::Integer: out = value.toLongLong(); return true;
+	case Common::BaseValidator::Boolean: out = value.toBool() ? 1 : 0; return true;
+	case Common::BaseValidator::Date: out = value.toDate().toJulianDay(); return value.toDate().isValid();
+	case Common::BaseValidator::Time: out = value.toTime().msecsSinceStartOfDay(); return value.toTime().isValid();
+	case Common::BaseValidator::DateTime: out = value.toDateTime().toMSecsSinceEpoch(); return value.toDateTime().isValid();
+	default: return false;
+	}
+}
+
+ColumnStore::ColumnStore(const Common::Table table)
+	: m_table(table), m_schema(Common::tableSchema(table)), m_validator(Common::BaseValidator::getValidator(table))
+{
+	for (const Common::FieldSchema &field : m_schema) {
+		Column column;
+		column.type = field.type;
+		switch (field.type) {
+		case Common::BaseValidator::ID:
+		case Common::BaseValidator::Integer:
+		case Common::BaseValidator::Boolean:
+		case Common::BaseValidator::Date:
+		case Common::BaseValidator::Time:
+		case Common::BaseValidator::DateTime:
+			column.kind = Column::Integer;
+			break;
+		case Common::BaseValidator::Real:
+			column.kind = Column::Real;
+			break;
+		case Common::BaseValidator::String:
+		case Common::BaseValidator::IP:
+			column.kind = Column::String;
+			break;
+		case Common::BaseValidator::Char:
+		case Common::BaseValidator::JSON:
+			column.kind = Column::Variant;
+			break;
+		}
+		m_columns.append(column);
+	}
+	clear();
+}
+
+void ColumnStore::clear()
+{
+	m_ids.clear();
+	m_revisions.clear();
+	m_rows.clear();
+	for (Column &column : m_columns) {
+		column.present.clear();
+		column.integers.clear();
+		column.reals.clear();
+		column.codes.clear();
+		column.variants.clear();
+		column.dictionary = {QString()};
+		column.dictionaryCodes.clear();
+	}
+}
+
+void ColumnStore::upsert(const Common::Record &record)
+{
+	int row = m_rows.value(record.id(), -1);
+	if (row == -1) {
+		row = m_ids.size();
+		m_ids.append(record.id());
+		m_revisions.append(record.latestRevision());
+		m_rows.insert(record.id(), row);
+		for (Column &column : m_columns) {
+			if (row % 64 == 0) {
+				column.present.append(0);
+			}
+			switch (column.kind) {
+			case Column::Integer: column.integers.append(0); break;
+			case Column::Real: column.reals.append(0); break;
+			case Column::String: column.codes.append(0); break;
+			case Column::Variant: column.variants.append(QVariant()); break;
+			}
+		}
+	} else {
+		m_revisions[row] = record.latestRevision();
+	}
+
+	for (int i = 0; i < m_columns.size(); ++i) {
+		setValue(m_columns[i], row, i, record.value(i));
+	}
+}
+
+void ColumnStore::remove(const Common::Id id)
+{
+	const auto it = m_rows.find(id);
+	if (it == m_rows.end()) {
+		return;
+	}
+	const int row = it.value();
+	const int last = m_ids.size() - 1;
+	m_rows.erase(it);
+
+	if (row != last) {
+		m_ids[row] = m_ids.at(last);
+		m_revisions[row] = m_revisions.at(last);
+		m_rows.insert(m_ids.at(row), row);
+		for (Column &column : m_columns) {
+			setBit(column.present, row, testBit(column.present, last));
+			switch (column.kind) {
+			case Column::Integer: column.integers[row] = column.integers.at(last); break;
+			case Column::Real: column.reals[row] = column.reals.at(last); break;
+			case Column::String: column.codes[row] = column.codes.at(last); break;
+			case Column::Variant: column.variants[row] = column.variants.at(last); break;
+			}
+		}
+	}
+
+	m_ids.removeLast();
+	m_revisions.removeLast();
+	for (Column &column : m_columns) {
+		if (last % 64 == 0) {
+			column.present.removeLast();
+		} else {
+			setBit(column.present, last, false);
+		}
+		switch (column.kind) {
+		case Column::Integer: column.integers.removeLast(); break;
+		case Column::Real: column.reals.removeLast(); break;
+		case Column::String: column.codes.removeLast(); break;
+		case Column::Variant: column.variants.removeLast(); break;
+		}
+	}
+}
+
+Common::Record ColumnStore::read(const Common::Id id) const
+{
+	const int row = m_rows.value(id, -1);
+	return row == -1 ? Common::Record() : materialize(row);
+}
+
+std::optional<QVector<Common::Record>> ColumnStore::find(const Common::TableQuery &query) const
+{
+	const QVector<Common::TableFilter> filters = query.filters();
+
+	// lookup of a single record, this is what DatabaseEngine::read() does
+	if (filters.size() == 1 && filters.first().field() == "id" && filters.first().op() == Common::TableFilter::Equal) {
+		QVariant id = filters.first().value();
+		if (!id.convert(qMetaTypeId<Common::Id>())) {
+			return {};
+		}
+		const int row = m_rows.value(id.value<Common::Id>(), -1);
+		return row == -1 ? QVector<Common::Record>() : QVector<Common::Record>{materialize(row)};
+	}
+	// lookup of a set of records
+	if (filters.size() == 1 && filters.first().field() == "id" && filters.first().op() == Common::TableFilter::In) {
+		QVector<Common::Id> ids;
+		for (QVariant id : filters.first().value().toList()) {
+			if (!id.convert(qMetaTypeId<Common::Id>())) {
+				return {};
+			}
+			ids.append(id.value<Common::Id>());
+		}
+		std::sort(ids.begin(), ids.end());
+		ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+		QVector<Common::Record> records;
+		for (const Common::Id id : ids) {
+			const int row = m_rows.value(id, -1);
+			if (row != -1) {
+				records.append(materialize(row));
+			}
+		}
+		return records;
+	}
+
+	Bitmap selection = allRows();
+	for (const Common::TableFilter &filter : filters) {
+		if (!scan(filter, selection)) {
+			return {};
+		}
+	}
+
+	QVector<int> rows;
+	for (int word = 0; word < selection.size(); ++word) {
+		quint64 bits = selection.at(word);
+		while (bits != 0) {
+			rows.append(word * 64 + int(qCountTrailingZeroBits(bits)));
+			bits &= bits - 1;
+		}
+	}
+	// same order as the database would return them in
+	std::sort(rows.begin(), rows.end(), [this](const int a, const int b) { return m_ids.at(a) < m_ids.at(b); });
+
+	QVector<Common::Record> records;
+	records.reserve(rows.size());
+	for (const int row : rows) {
+		records.append(materialize(row));
+	}
+	return records;
+}
+
+void ColumnStore::setValue(Column &column, const int row, const int fieldIndex, const QVariant &value)
+{
+	setBit(column.present, row, !value.isNull());
+	if (value.isNull()) {
+		switch (column.kind) {
+		case Column::Integer: column.integers[row] = 0; break;
+		case Column::Real: column.reals[row] = 0; break;
+		case Column::String: column.codes[row] = 0; break;
+		case Column::Variant: column.variants[row] = QVariant(); break;
+		}
+		return;
+	}
+
+	const QVariant coerced = m_validator->coerce(fieldIndex, value);
+	switch (column.kind) {
+	case Column::Integer:
+		if (!toInteger(column.type, coerced, column.integers[row])) {
+			throw Common::CoercionException(QStringLiteral("Unable to store value of field %1 in a column")
+											.arg(m_schema.field(fieldIndex).name));
+		}
+		break;
+	case Column::Real:
+		column.reals[row] = coerced.toDouble();
+		break;
+	case Column::String: {
+		const QString string = coerced.toString();
+		qint32 code = column.dictionaryCodes.value(string, 0);
+		if (code == 0) {
+			code = column.dictionary.size();
+			column.dictionary.append(string);
+			column.dictionaryCodes.insert(string, code);
+		}
+		column.codes[row] = code;
+		break;
+	}
+	case Column::Variant:
+		column.variants[row] = coerced;
+		break;
+	}
+}
+
+QVariant ColumnStore::value(const Column &column, const int row) const
+{
+	if (!testBit(column.present, row)) {
+		return QVariant();
+	}
+
+	switch (column.kind) {
+	case Column::Integer: {
+		const qint64 integer = column.integers.at(row);
+		switch (column.type) {
+		case Common::BaseValidator::ID: return QVariant::fromValue<Common::Id>(Common::Id(integer));
+		case Common::BaseValidator::Boolean: return QVariant(integer != 0);
+		case Common::BaseValidator::Date: return QDate::fromJulianDay(integer);
+		case Common::BaseValidator::Time: return QTime::fromMSecsSinceStartOfDay(int(integer));
+		case Common::BaseValidator::DateTime: return QDateTime::fromMSecsSinceEpoch(integer);
+		default: return QVariant(qlonglong(integer));
+		}
+	}
+	case Column::Real: return column.reals.at(row);
+	case Column::String: return column.dictionary.at(column.codes.at(row));
+	case Column::Variant: return column.variants.at(row);
+	}
+}
+
+ColumnStore::Bitmap ColumnStore::allRows() const
+{
+	Bitmap selection((size() + 63) / 64, ~quint64(0));
+	if (size() % 64 != 0) {
+		selection.last() = (quint64(1) << (size() % 64)) - 1;
+	}
+	return selection;
+}
+
+bool ColumnStore::scan(const Common::TableFilter &filter, Bitmap &selection) const
+{
+	switch (filter.op()) {
+	case Common::TableFilter::Equal:
+	case Common::TableFilter::NotEqual:
+	case Common::TableFilter::Less:
+	case Common::TableFilter::LessEqual:
+	case Common::TableFilter::Greater:
+	case Common::TableFilter::GreaterEqual:
+		break;
+	case Common::TableFilter::In:
+	case Common::TableFilter::Between:
+	case Common::TableFilter::StartsWith:
+	case Common::TableFilter::IsNull:
+		// only plain comparisons have scan kernels, the rest is left to the database
+		return false;
+	case Common::TableFilter::And:
+		for (const Common::TableFilter &child : filter.children()) {
+			if (!scan(child, selection)) {
+				return false;
+			}
+		}
+		return true;
+	case Common::TableFilter::Or: {
+		Bitmap any(selection.size(), 0);
+		for (const Common::TableFilter &child : filter.children()) {
+			Bitmap branch = allRows();
+			if (!scan(child, branch)) {
+				return false;
+			}
+			unite(any, branch);
+		}
+		intersect(selection, any);
+		return true;
+	}
+	case Common::TableFilter::Not:
+		// the complement of a selection would include NULL values, which never match in SQL
+		return false;
+	}
+
+	if (filter.field() == "id") {
+		QVariant id = filter.value();
+		if (!id.convert(qMetaTypeId<Common::Id>())) {
+			return false;
+		}
+		scanColumn(m_ids, filter.op(), id.value<Common::Id>(), selection);
+		return true;
+	}
+
+	const int index = m_schema.indexOf(filter.field());
+	if (index == -1) {
+		// leave reporting unknown fields to the database
+		return false;
+	}
+	const Column &column = m_columns.at(index);
+
+	QVariant value;
+	try {
+		value = m_validator->coerce(index, filter.value());
+	} catch (Common::CoercionException &) {
+		return false;
+	}
+
+	switch (column.kind) {
+	case Column::Integer: {
+		qint64 integer;
+		if (!toInteger(column.type, value, integer)) {
+			return false;
+		}
+		scanColumn(column.integers, filter.op(), integer, selection);
+		break;
+	}
+	case Column::Real:
+		scanColumn(column.reals, filter.op(), value.toDouble(), selection);
+		break;
+	case Column::String:
+		if (!m_binaryStrings) {
+			return false;
+		}
+		if (filter.op() == Common::TableFilter::Equal || filter.op() == Common::TableFilter::NotEqual) {
+			// strings are equal exactly if their codes are, a string that is not in the dictionary matches no row
+			const qint32 code = column.dictionaryCodes.value(value.toString(), -1);
+			scanColumn(column.codes, filter.op(), code, selection);
+		} else {
+			// ordered comparisons are evaluated once per distinct string and then looked up for every row
+			QVector<quint8> matches(column.dictionary.size(), 0);
+			for (int i = 1; i < column.dictionary.size(); ++i) {
+				matches[i] = compareStrings(column.dictionary.at(i), filter.op(), value.toString()) ? 1 : 0;
+			}
+			for (int word = 0, offset = 0; offset < size(); ++word, offset += 64) {
+				const int count = std::min(64, size() - offset);
+				quint64 bits = 0;
+				for (int i = 0; i < count; ++i) {
+					bits |= quint64(matches.at(column.codes.at(offset + i))) << i;
+				}
+				selection[word] &= bits;
+			}
+		}
+		break;
+	case Column::Variant:
+		return false;
+	}
+
+	// comparisons with NULL never match, same as in SQL
+	intersect(selection, column.present);
+	return true;
+}
+
+Common::Record ColumnStore::materialize(const int row) const
+{
+	Common::Record record(m_table);
+	record.setId(m_ids.at(row));
+	record.setLatestRevision(m_revisions.at(row));
+	for (int i = 0; i < m_columns.size(); ++i) {
+		record.setValue(i, value(m_columns.at(i), row));
+	}
+	record.setComplete(true);
+	return record;
+}
+
+}
+}
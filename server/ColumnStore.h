@@ -0,0 +1,84 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+
+#include "commonlib/Validators.h"
+#include "commonlib/Schema.h"
+#include "RecordStore.h"
+
+namespace Sportsed {
+namespace Server {
+
+/// Column-wise in-memory copy of the non-deleted records of a table
+///
+/// Integer-like fields (ids, foreign keys, integers, booleans, dates and times) are stored in contiguous int64 arrays,
+/// strings are dictionary encoded. Filters are evaluated by scanning entire columns into selection bitmaps, one bit per
+/// row, which are then combined. Rows are kept dense, removing a row moves the last row into its place.
+class ColumnStore : public RecordStore
+{
+public:
+	explicit ColumnStore(const Common::Table table);
+
+	Common::Table table() const override { return m_table; }
+	int size() const override { return m_ids.size(); }
+
+	void clear() override;
+	/// Throws a CoercionException if a value does not fit its column
+	void upsert(const Common::Record &record) override;
+	void remove(const Common::Id id) override;
+
+	/// Strings are compared by their UTF-16 code units, which only agrees with binary collations of the database. Without
+	/// one, filters on strings are left to the database
+	void setBinaryStrings(const bool binary) { m_binaryStrings = binary; }
+	bool hasBinaryStrings() const { return m_binaryStrings; }
+
+	Common::Record read(const Common::Id id) const override;
+	/// Returns nothing if the query contains filters that only the database is able to evaluate (multi-level fields,
+	/// JSON fields, operators other than comparisons, AND and OR except for id lookups, or values that do not fit the
+	/// column)
+	std::optional<QVector<Common::Record>> find(const Common::TableQuery &query) const override;
+
+private:
+	using Bitmap = QVector<quint64>;
+
+	struct Column
+	{
+		enum Kind
+		{
+			Integer,
+			Real,
+			String,
+			Variant
+		};
+
+		Common::BaseValidator::FieldType type;
+		Kind kind;
+		Bitmap present; // unset for NULL values
+		QVector<qint64> integers;
+		QVector<double> reals;
+		QVector<qint32> codes; // index into dictionary, 0 is reserved for NULL
+		QVector<QString> dictionary;
+		QHash<QString, qint32> dictionaryCodes;
+		QVector<QVariant> variants;
+	};
+
+	Common::Table m_table;
+	const Common::TableSchema &m_schema;
+	Common::BaseValidator *m_validator;
+	QVector<Common::Id> m_ids;
+	QVector<Common::Revision> m_revisions;
+	QHash<Common::Id, int> m_rows;
+	QVector<Column> m_columns; // in the order of the table schema
+	bool m_binaryStrings = true;
+
+	void setValue(Column &column, const int row, const int fieldIndex, const QVariant &value);
+	QVariant value(const Column &column, const int row) const;
+	Bitmap allRows() const;
+	/// Narrows the selection down to the rows matching the filter, returns false if the filter can not be evaluated
+	bool scan(const Common::TableFilter &filter, Bitmap &selection) const;
+	Common::Record materialize(const int row) const;
+};
+
+}
+}
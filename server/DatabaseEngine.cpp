@@ -6,9 +6,16 @@
 #include <QSqlQuery>
 #include <QSqlError>
 #include <QDateTime>
+#include <QJsonDocument>
 #include <QDebug>
+#include <QSet>
 
 #include <jd-util/Formatting.h>
+#include <jd-util/Json.h>
+
+#include "commonlib/Validators.h"
+#include "commonlib/Schema.h"
+#include "Journal.h"
 
 #include "config.h"
 
@@ -16,48 +23,83 @@ using namespace JD::Util;
 
 namespace Sportsed {
 namespace Server {
+Q_LOGGING_CATEGORY(engine, "sportsed.server.engine")
+
+/// All tables that contain records, as opposed to the bookkeeping tables meta and change
+static constexpr Common::Table recordTables[] = {
+	Common::Table::Profile, Common::Table::Client, Common::Table::Competition, Common::Table::Stage,
+	Common::Table::Course, Common::Table::Control, Common::Table::CourseControl, Common::Table::Class
+};
+
+/// Replies to change queries that are not compacted hold at most this many changes
+static constexpr int maxChangesPerReply = 100;
+/// Ids are looked up in batches of this size, bound parameters are limited by the databases
+static constexpr int maxIdsPerQuery = 500;
 
-static QPair<QString, QVector<QVariant>> whereForQuery(const Common::TableQuery &query)
+static QString encodePostImage(const QJsonObject &values)
 {
-	QStringList joins;
-	QStringList items;
-	items.append("1 = 1"); // eliminates the need for special casing an empty query in the caller
-	QVector<QVariant> values;
-	for (const Common::TableFilter &filter : query.filters()) {
-		QString op;
-		switch (filter.op()) {
-		case Sportsed::Common::TableFilter::Equal: op = '='; break;
-		case Sportsed::Common::TableFilter::NotEqual: op = "<>"; break;
-		case Sportsed::Common::TableFilter::Less: op = '<'; break;
-		case Sportsed::Common::TableFilter::LessEqual: op = "<="; break;
-		case Sportsed::Common::TableFilter::Greater: op = ">"; break;
-		case Sportsed::Common::TableFilter::GreaterEqual: op = ">="; break;
-		}
-
-		if (filter.field().contains('>')) {
-			// special filtering in the format table_a_id>table_b_id>table_c_id that will use joins to match the table_a_id field
-			// in the current table against the id field in table_a, table_b_id in table_a against table_b.id etc. and table_c_id
-			// against the given value
-
-			const QStringList fields = filter.field().split('>');
-			QString join;
-			for (int i = 0; i < fields.size(); ++i) {
-				if (i != (fields.size()-1)) {
-					const QString field = fields.at(i);
-					const QString table = QString(field).remove("_id");
-					const QString prevTable = i == 0 ? Common::tableName(query.table()) : QString(fields.at(i-1)).remove("_id");
-					join += QStringLiteral(" JOIN %1 ON %1.id = %2.%3").arg(table, prevTable, field);
-				}
-			}
-			joins.append(join);
-			items.append(QStringLiteral("%1.%2 %3 ?").arg(QString(fields.at(fields.size()-2)).remove("_id"), fields.last(), op));
-		} else {
-			// normal filtering
-			items.append(QStringLiteral("%1.%2 %3 ?").arg(Common::tableName(query.table()), filter.field(), op));
+	return QString::fromUtf8(QJsonDocument(values).toJson(QJsonDocument::Compact));
+}
+static Common::Record decodePostImage(const Common::Table table, const Common::Id id, const Common::Revision revision,
+									  const QJsonObject &values)
+{
+	Common::BaseValidator *validator = Common::BaseValidator::getValidator(table);
+	const Common::TableSchema &schema = Common::tableSchema(table);
+
+	Common::Record record(table);
+	record.setId(id);
+	record.setLatestRevision(revision);
+	for (auto it = values.constBegin(); it != values.constEnd(); ++it) {
+		QVariant value = it.value().toVariant();
+		const int index = schema.indexOf(it.key());
+		if (index == -1) {
+			record.setValue(it.key(), value);
+			continue;
+		}
+		try {
+			value = validator->coerce(index, value);
+		} catch (Common::CoercionException &) {
+			// keep the value as stored, same as when reading it from the table
+		}
+		record.setValue(index, Common::internValue(schema.field(index), value));
+	}
+	record.setComplete(true);
+	return record;
+}
+
+/// Applies the sorting, cursor and limit of the query to records found in a resident table, which are ordered by id
+static void orderRecords(QVector<Common::Record> &records, const Common::TableQuery &query)
+{
+	if (!query.after().isEmpty()) {
+		records.erase(std::remove_if(records.begin(), records.end(), [&query](const Common::Record &record) {
+			return !query.isAfterCursor(record);
+		}), records.end());
+	}
+	if (!query.sort().isEmpty()) {
+		std::sort(records.begin(), records.end(), [&query](const Common::Record &a, const Common::Record &b) {
+			return query.lessThan(a, b);
+		});
+	}
+	if (query.limit() > 0 && records.size() > query.limit()) {
+		records.resize(query.limit());
+	}
+}
+/// Reduces a complete record to the given fields, the id and revision are always kept
+static Common::Record project(const Common::Record &record, const QVector<QString> &fields)
+{
+	if (fields.isEmpty()) {
+		return record;
+	}
+	Common::Record projected(record.table());
+	projected.setId(record.id());
+	projected.setLatestRevision(record.latestRevision());
+	for (const QString &field : fields) {
+		const int index = projected.fieldIndex(field);
+		if (index != -1 && record.hasValue(index)) {
+			projected.setValue(index, record.value(index));
 		}
-		values.append(filter.value());
 	}
-	return qMakePair(joins.join(" ") + " WHERE " + items.join(" AND "), values);
+	return projected;
 }
 
 DatabaseEngine::DatabaseEngine(QSqlDatabase &db)
@@ -66,10 +108,36 @@ DatabaseEngine::DatabaseEngine(QSqlDatabase &db)
 	if (db.tables().isEmpty()) {
 		throw ValidationException("Database %1 (connection: %2) contains no fields" % m_db.databaseName() % m_db.connectionName());
 	}
+	// the default collation of SQLite compares strings as bytes, MySQL ignores case and PostgreSQL uses the locale
+	m_binaryStrings = db.driverName() == "QSQLITE";
+
 	Database::exec(db.exec(QStringLiteral("DELETE FROM %1 WHERE 1=1").arg(Common::tableName(Common::Table::Client))));
 	Database::exec(db.exec(QStringLiteral("DELETE FROM %1 WHERE record_table = %2").arg(
 							   Common::tableName(Common::Table::Change),
 							   db.driver()->escapeIdentifier(Common::tableName(Common::Table::Client), QSqlDriver::TableName))));
+
+	QSqlQuery checkpoint = Database::prepare("SELECT value FROM meta WHERE key = 'checkpoint'", m_db);
+	Database::exec(checkpoint);
+	if (checkpoint.next()) {
+		m_checkpoint = checkpoint.value(0).value<Common::Revision>();
+	}
+
+	QSqlQuery revisions = Database::prepare(QStringLiteral("SELECT record_table, MAX(id) FROM %1 GROUP BY record_table")
+											.arg(m_db.driver()->escapeIdentifier(Common::tableName(Common::Table::Change), QSqlDriver::TableName)),
+											m_db);
+	Database::exec(revisions);
+	while (revisions.next()) {
+		const Common::Revision revision = revisions.value(1).value<Common::Revision>();
+		m_tableRevisions.insert(Common::fromTableName(revisions.value(0).toString()), revision);
+		m_latestRevision = std::max(m_latestRevision, revision);
+	}
+	m_latestRevision = std::max(m_latestRevision, m_checkpoint);
+
+	// small tables that are looked up all the time
+	for (const Common::Table table : {Common::Table::Stage, Common::Table::Course, Common::Table::Control, Common::Table::Class}) {
+		setCacheLimit(table, 10000);
+		setResident(table, true);
+	}
 }
 
 Common::ChangeResponse DatabaseEngine::changes(const Common::ChangeQuery &query)
@@ -77,6 +145,18 @@ Common::ChangeResponse DatabaseEngine::changes(const Common::ChangeQuery &query)
 	Common::ChangeResponse response;
 	response.setQuery(query);
 
+	response.setLastRevision(m_latestRevision);
+
+	// a from revision of 0 means "everything that is available", so that clients without any data do not resync forever
+	if (query.fromRevision() != 0 && query.fromRevision() < m_checkpoint) {
+		response.setResyncRequired(true);
+		return response;
+	}
+	if (!query.query().isNull() && tableRevision(query.query().table()) <= query.fromRevision()) {
+		// nothing has happened in this table since, no need to even look at the change log
+		return response;
+	}
+
 	QString where = "1=0";
 	QVector<QVariant> values;
 	// TODO: extend filter implementation to all fields
@@ -93,23 +173,22 @@ Common::ChangeResponse DatabaseEngine::changes(const Common::ChangeQuery &query)
 		where += ")";
 	}
 
-	QSqlQuery sqlQuery = Database::prepare(QStringLiteral("SELECT type,id,record_id,record_table,fields FROM %1 WHERE id > ? AND (%2) ORDER BY id ASC LIMIT 100")
+	// the entire range is scanned for a compacted reply, but changes are merged as they are read so that only one change
+	// per record is held at a time
+	QSqlQuery sqlQuery = Database::prepare(QStringLiteral("SELECT type,id,record_id,record_table,fields,data FROM %1 WHERE id > ? AND (%2) ORDER BY id ASC %3")
 										   % m_db.driver()->escapeIdentifier(Common::tableName(Common::Table::Change), QSqlDriver::TableName)
-										   % where,
+										   % where
+										   % (query.isCompact() ? QString() : QStringLiteral("LIMIT %1").arg(maxChangesPerReply)),
 										   m_db);
 	sqlQuery.addBindValue(query.fromRevision());
 	for (const QVariant &value : values) {
 		sqlQuery.addBindValue(value);
 	}
 
-	// TODO would it be possible to get a read-only lock?
-	Database::TransactionLocker locker(m_db);
-	const auto latest = Database::execOne(m_db.exec("SELECT id FROM %1 ORDER BY id DESC LIMIT 1"
-													% m_db.driver()->escapeIdentifier(Common::tableName(Common::Table::Change), QSqlDriver::TableName)));
 	Database::exec(sqlQuery);
-	locker.rollback(); // no changes done, so might just as well roll back
 
 	QVector<Common::Change> changes;
+	Common::ChangeCompactor compactor;
 	while (sqlQuery.next()) {
 		const QChar typeChar = sqlQuery.value(0).toString().at(0);
 		Common::Change::Type type;
@@ -122,15 +201,40 @@ Common::ChangeResponse DatabaseEngine::changes(const Common::ChangeQuery &query)
 
 		Common::Change change(type);
 		change.setRevision(sqlQuery.value(1).value<Common::Revision>());
-		change.setRecord(read(Common::fromTableName(sqlQuery.value(3).toString()),
-							  sqlQuery.value(2).value<Common::Id>(),
-							  true));
-		change.setUpdatedFields(sqlQuery.value(4).toString().split(',', QString::SkipEmptyParts).toVector());
-		changes.append(change);
+		const Common::Table table = Common::fromTableName(sqlQuery.value(3).toString());
+		const Common::Id recordId = sqlQuery.value(2).value<Common::Id>();
+		if (sqlQuery.isNull(5)) {
+			// changes recorded before post-images were stored only have the current state available
+			change.setRecord(read(table, recordId, true));
+		} else {
+			change.setRecord(decodePostImage(table, recordId, change.revision(),
+												   Json::ensureObject(Json::ensureDocument(sqlQuery.value(5).toByteArray()))));
+		}
+		QVector<QString> updatedFields;
+		for (const QString &field : sqlQuery.value(4).toString().split(',', QString::SkipEmptyParts)) {
+			updatedFields.append(Common::sharedFieldName(table, field));
+		}
+		change.setUpdatedFields(std::move(updatedFields));
+		if (query.isCompact()) {
+			compactor.add(change);
+		} else {
+			changes.append(change);
+		}
 	}
 
-	response.setChanges(changes);
-	response.setLastRevision(latest.at(0).value<Common::Revision>());
+	if (query.isCompact()) {
+		changes = compactor.changes();
+	} else if (changes.size() == maxChangesPerReply) {
+		// cut short, the changes after the last one are still to be fetched
+		response.setLastRevision(changes.last().revision());
+	}
+	if (query.isDelta()) {
+		for (Common::Change &change : changes) {
+			change = change.toDelta();
+		}
+	}
+
+	response.setChanges(std::move(changes));
 	return response;
 }
 
@@ -150,8 +254,8 @@ Common::Record DatabaseEngine::create(const Common::Record &record)
 
 	QStringList fields;
 	QStringList values;
-	for (auto it = record.values().constBegin(); it != record.values().constEnd(); ++it) {
-		fields.append(m_db.driver()->escapeIdentifier(it.key(), QSqlDriver::FieldName));
+	for (const QString &field : record.fields()) {
+		fields.append(m_db.driver()->escapeIdentifier(field, QSqlDriver::FieldName));
 		values.append("?");
 	}
 
@@ -160,8 +264,8 @@ Common::Record DatabaseEngine::create(const Common::Record &record)
 											fields.join(','),
 											values.join(',')),
 										m_db);
-	for (const QVariant &val : record.values()) {
-		query.addBindValue(val);
+	for (const QString &field : record.fields()) {
+		query.addBindValue(record.value(field));
 	}
 
 
@@ -170,22 +274,98 @@ Common::Record DatabaseEngine::create(const Common::Record &record)
 
 	Common::Record inserted = record;
 	inserted.setId(query.lastInsertId().value<Common::Id>());
-	insertChange(Common::tableName(inserted.table()), inserted.id(), Common::Change::Create, inserted);
+	const RecordedChange change = insertChange(Common::tableName(inserted.table()), inserted.id(), Common::Change::Create, inserted);
 	locker.commit();
+	applyChange(change);
 
 	return complete(inserted);
 }
 
-Common::Record DatabaseEngine::read(const Common::Table &table, const Common::Id id, const bool includeDeleted)
+Common::Record DatabaseEngine::read(const Common::Table &table, const Common::Id id, const bool includeDeleted,
+									const QVector<QString> &fields)
 {
-	const QVector<Common::Record> rows = find(Common::TableQuery(table, Common::TableFilter("id", id)), includeDeleted);
+	Common::TableQuery query(table, Common::TableFilter("id", id));
+	query.setFields(fields);
+	const QueryPlan plan(query, m_db.driver());
+
+	if (m_caches.contains(table)) {
+		if (const Common::Record *cached = m_caches.value(table)->object(id)) {
+			++m_cacheHits;
+			return project(*cached, fields);
+		}
+		++m_cacheMisses;
+	}
+	if (!includeDeleted && m_resident.contains(table)) {
+		const Common::Record record = m_resident.value(table)->read(id);
+		if (record.isNull()) {
+			throw Database::DoesntExistException();
+		}
+		return project(record, fields);
+	}
+
+	const QVector<Common::Record> rows = find(plan, includeDeleted);
 	if (rows.size() == 0) {
 		throw Database::DoesntExistException();
 	}
 	return rows.first();
 }
 
-Common::Revision DatabaseEngine::update(const Common::Record &record)
+QVector<Common::Record> DatabaseEngine::readMany(const Common::Table &table, const QVector<Common::Id> &ids)
+{
+	// cached records are taken as they are, all others are read with as few queries as possible
+	QHash<Common::Id, Common::Record> found;
+	QSet<Common::Id> seen;
+	QVariantList missing;
+	const std::shared_ptr<QCache<Common::Id, Common::Record>> cache = m_caches.value(table);
+	for (const Common::Id id : ids) {
+		if (seen.contains(id)) {
+			continue;
+		}
+		seen.insert(id);
+		if (cache) {
+			if (const Common::Record *cached = cache->object(id)) {
+				++m_cacheHits;
+				found.insert(id, *cached);
+				continue;
+			}
+			++m_cacheMisses;
+		}
+		missing.append(QVariant::fromValue(id));
+	}
+	for (const Common::Record &record : findByIds(table, missing)) {
+		found.insert(record.id(), record);
+	}
+
+	QVector<Common::Record> records;
+	records.reserve(ids.size());
+	for (const Common::Id id : ids) {
+		records.append(found.value(id));
+	}
+	return records;
+}
+
+Common::ConditionalResult DatabaseEngine::readIfModified(const Common::Table &table, const Common::Id id, const Common::Revision since)
+{
+	const Common::Revision revision = m_latestRevision;
+	if (tableRevision(table) <= since) {
+		return Common::ConditionalResult(revision);
+	}
+	const Common::Record record = read(table, id);
+	if (record.latestRevision() <= since) {
+		return Common::ConditionalResult(revision);
+	}
+	return Common::ConditionalResult(revision, {record});
+}
+
+/// Compare-and-set condition on the revision of the record, binds the table name and the expected revision. Records that
+/// have not changed since the last checkpoint are of the checkpoint revision, same as in findInDatabase()
+static QString revisionCondition(const QString &escapedTable, const Common::Revision checkpoint)
+{
+	return QStringLiteral(" AND COALESCE((SELECT change.id FROM change WHERE change.record_id = %1.id AND change.record_table = ? ORDER BY change.id DESC LIMIT 1), %2) = ?")
+			.arg(escapedTable).arg(checkpoint);
+}
+
+Common::Revision DatabaseEngine::update(const Common::Record &record, const std::optional<Common::Revision> &expectedRevision)
 {
 	if (record.isNull()) {
 		throw ValidationException("Cannot update null record");
@@ -202,89 +382,393 @@ Common::Revision DatabaseEngine::update(const Common::Record &record)
 
 	QStringList fields;
 	QVector<QVariant> values;
-	for (auto it = record.values().constBegin(); it != record.values().constEnd(); ++it) {
-		fields.append(m_db.driver()->escapeIdentifier(it.key(), QSqlDriver::FieldName) + " = ?");
-		values.append(it.value());
+	for (const QString &field : record.fields()) {
+		fields.append(m_db.driver()->escapeIdentifier(field, QSqlDriver::FieldName) + " = ?");
+		values.append(record.value(field));
 	}
 
-	QSqlQuery query = Database::prepare(QStringLiteral("UPDATE %1 SET %2 WHERE id = %3 AND _deleted_ = 0")
-										% m_db.driver()->escapeIdentifier(Common::tableName(record.table()), QSqlDriver::TableName)
+	const QString tableName = m_db.driver()->escapeIdentifier(Common::tableName(record.table()), QSqlDriver::TableName);
+	QSqlQuery query = Database::prepare(QStringLiteral("UPDATE %1 SET %2 WHERE id = %3 AND _deleted_ = 0 %4")
+										% tableName
 										% fields.join(',')
-										% record.id(),
+										% record.id()
+										% (expectedRevision ? revisionCondition(tableName, m_checkpoint) : QString()),
 										m_db);
 	for (const QVariant &value : values) {
 		query.addBindValue(value);
 	}
+	if (expectedRevision) {
+		query.addBindValue(Common::tableName(record.table()));
+		query.addBindValue(*expectedRevision);
+	}
 
 	Database::TransactionLocker locker(m_db);
 	Database::exec(query);
-	const Common::Revision revision = insertChange(Common::tableName(record.table()), record.id(), Common::Change::Update, record);
+	// MySQL only counts rows that have been matched instead of actually changed with CLIENT_FOUND_ROWS, see main()
+	if (expectedRevision && query.numRowsAffected() == 0) {
+		throw ConflictException(QStringLiteral("Record has been changed or deleted after revision %1") % *expectedRevision);
+	}
+	const RecordedChange change = insertChange(Common::tableName(record.table()), record.id(), Common::Change::Update, record);
 	locker.commit();
+	applyChange(change);
 
-	return revision;
+	return change.change.revision();
 }
 
-Common::Revision DatabaseEngine::delete_(const Common::Table &table, const Common::Id id)
+Common::Revision DatabaseEngine::delete_(const Common::Table &table, const Common::Id id,
+										 const std::optional<Common::Revision> &expectedRevision)
 {
-	Common::Record record(table);
-	record.setId(id);
-	record = complete(record);
+	// a record that has been deleted since the expected revision is a conflict like any other change, not a missing one
+	const Common::Record record = read(table, id, static_cast<bool>(expectedRevision));
 
-	QSqlQuery query = Database::prepare("UPDATE %1 SET _deleted_ = 1 WHERE id = ?"
-										% m_db.driver()->escapeIdentifier(Common::tableName(table), QSqlDriver::TableName),
+	const QString tableName = m_db.driver()->escapeIdentifier(Common::tableName(table), QSqlDriver::TableName);
+	QSqlQuery query = Database::prepare(QStringLiteral("UPDATE %1 SET _deleted_ = 1 WHERE id = ? %2")
+										% tableName
+										% (expectedRevision ? " AND _deleted_ = 0" + revisionCondition(tableName, m_checkpoint) : QString()),
 										m_db);
 	query.addBindValue(id);
+	if (expectedRevision) {
+		query.addBindValue(Common::tableName(table));
+		query.addBindValue(*expectedRevision);
+	}
 
 	Database::TransactionLocker locker(m_db);
 	Database::exec(query);
-	const Common::Revision revision = insertChange(Common::tableName(table),
-												   id,
-												   Common::Change::Delete,
-												   record);
+	if (expectedRevision && query.numRowsAffected() == 0) {
+		throw ConflictException(QStringLiteral("Record has been changed or deleted after revision %1") % *expectedRevision);
+	}
+	const RecordedChange change = insertChange(Common::tableName(table),
+											   id,
+											   Common::Change::Delete,
+											   record);
 	locker.commit();
+	applyChange(change);
 
-	return revision;
+	return change.change.revision();
 }
 
 QVector<Common::Record> DatabaseEngine::find(const Common::TableQuery &query, const bool includeDeleted)
 {
-	const auto where = whereForQuery(query);
+	return find(QueryPlan(query, m_db.driver()), includeDeleted);
+}
+QVector<Common::Record> DatabaseEngine::find(const QueryPlan &plan, const bool includeDeleted)
+{
+	const Common::TableQuery &query = plan.query();
+	if (!includeDeleted && m_resident.contains(query.table()) && canOrderInMemory(query)) {
+		std::optional<QVector<Common::Record>> records = m_resident.value(query.table())->find(query);
+		if (records) {
+			orderRecords(*records, query);
+			if (query.isProjected()) {
+				for (Common::Record &record : *records) {
+					record = project(record, query.fields());
+				}
+			}
+			return *records;
+		}
+	}
+	return findInDatabase(plan, includeDeleted);
+}
+
+QVector<Common::Record> DatabaseEngine::findByIds(const Common::Table table, const QVariantList &ids)
+{
+	QVector<Common::Record> records;
+	for (int i = 0; i < ids.size(); i += maxIdsPerQuery) {
+		records += find(Common::TableQuery(table, Common::TableFilter("id", Common::TableFilter::In, ids.mid(i, maxIdsPerQuery))));
+	}
+	return records;
+}
+
+Common::ConditionalResult DatabaseEngine::findIfModified(const Common::TableQuery &query, const Common::Revision since)
+{
+	const QueryPlan plan(query, m_db.driver());
+	const Common::Revision revision = m_latestRevision;
+	if (queryRevision(query) <= since) {
+		return Common::ConditionalResult(revision);
+	}
+	return Common::ConditionalResult(revision, find(plan));
+}
+
+Common::FindResult DatabaseEngine::findIncluding(const Common::TableQuery &query)
+{
+	const QueryPlan plan(query, m_db.driver());
+	const QVector<Common::Record> records = find(plan);
+
+	// every level of every path only queries for the referenced records that have not been included yet
+	QHash<Common::Table, QHash<Common::Id, Common::Record>> known;
+	QVector<Common::Record> included;
+	for (const QString &include : query.includes()) {
+		Common::Table table = query.table();
+		QVector<Common::Record> current = records;
+		for (const QString &field : include.split('>')) {
+			const Common::Table target = referencedTable(table, field);
+			QHash<Common::Id, Common::Record> &knownOfTarget = known[target];
+
+			QVector<Common::Id> ids;
+			QSet<Common::Id> seen;
+			QVariantList missing;
+			for (const Common::Record &record : current) {
+				const QVariant value = record.value(field);
+				const Common::Id id = value.value<Common::Id>();
+				if (value.isNull() || seen.contains(id)) {
+					continue;
+				}
+				seen.insert(id);
+				ids.append(id);
+				if (!knownOfTarget.contains(id)) {
+					missing.append(QVariant::fromValue(id));
+				}
+			}
+			for (const Common::Record &record : findByIds(target, missing)) {
+				knownOfTarget.insert(record.id(), record);
+				included.append(record);
+			}
+
+			current.clear();
+			for (const Common::Id id : ids) {
+				if (knownOfTarget.contains(id)) {
+					current.append(knownOfTarget.value(id));
+				}
+			}
+			table = target;
+		}
+	}
+
+	return Common::FindResult(records, included);
+}
+
+Common::Snapshot DatabaseEngine::snapshot(const QVector<Common::TableQuery> &queries)
+{
+	// all queries are validated before anything is read
+	QVector<QueryPlan> plans;
+	for (const Common::TableQuery &query : queries) {
+		plans.append(QueryPlan(query, m_db.driver()));
+	}
 
+	Common::Snapshot snapshot;
+	snapshot.setRevision(m_latestRevision);
+	for (const QueryPlan &plan : plans) {
+		snapshot.add(plan.query(), find(plan));
+	}
+	return snapshot;
+}
+
+int DatabaseEngine::findStreamed(const Common::TableQuery &query, const RecordCallback &cb, const bool includeDeleted)
+{
+	return findStreamed(QueryPlan(query, m_db.driver()), cb, includeDeleted);
+}
+int DatabaseEngine::findStreamed(const QueryPlan &plan, const RecordCallback &cb, const bool includeDeleted)
+{
+	const Common::TableQuery &query = plan.query();
+	if (!includeDeleted && m_resident.contains(query.table()) && canOrderInMemory(query)) {
+		std::optional<QVector<Common::Record>> records = m_resident.value(query.table())->find(query);
+		if (records) {
+			orderRecords(*records, query);
+			for (const Common::Record &record : *records) {
+				cb(project(record, query.fields()));
+			}
+			return records->size();
+		}
+	}
+	return findInDatabase(plan, includeDeleted, cb);
+}
+
+bool DatabaseEngine::canOrderInMemory(const Common::TableQuery &query) const
+{
+	if (m_binaryStrings) {
+		return true;
+	}
+	// see orderRecords(), strings would be sorted differently than by the database
+	const Common::TableSchema &schema = Common::tableSchema(query.table());
+	for (const Common::TableSort &sort : query.sort()) {
+		const int index = schema.indexOf(sort.field());
+		if (index != -1 && (schema.field(index).type == Common::BaseValidator::String || schema.field(index).type == Common::BaseValidator::IP)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+QVector<Common::Record> DatabaseEngine::findInDatabase(const QueryPlan &plan, const bool includeDeleted)
+{
+	QVector<Common::Record> records;
+	findInDatabase(plan, includeDeleted, [&records](const Common::Record &record) { records.append(record); });
+	return records;
+}
+int DatabaseEngine::findInDatabase(const QueryPlan &plan, const bool includeDeleted, const RecordCallback &cb)
+{
+	const Common::TableQuery &query = plan.query();
 	const QString tableName = m_db.driver()->escapeIdentifier(Common::tableName(query.table()), QSqlDriver::TableName);
+	QString selection = tableName + ".*";
+	if (query.isProjected()) {
+		QStringList names{tableName + ".id"};
+		for (const QString &field : query.fields()) {
+			if (field != "id") {
+				names.append(tableName + '.' + m_db.driver()->escapeIdentifier(field, QSqlDriver::FieldName));
+			}
+		}
+		selection = names.join(", ");
+	}
 	QSqlQuery sql = Database::prepare(
-				QStringLiteral("SELECT %1.*, (SELECT change.id FROM change WHERE change.record_id = %1.id AND change.record_table = %1 ORDER BY change.id DESC LIMIT 1) AS _latest_revision_ FROM %1 %2 %3") %
+				// records that have not changed since the last checkpoint are reported as being of the checkpoint revision
+				QStringLiteral("SELECT %5, COALESCE((SELECT change.id FROM change WHERE change.record_id = %1.id AND change.record_table = %1 ORDER BY change.id DESC LIMIT 1), %4) AS _latest_revision_ FROM %1 %2 %3 %6") %
 				tableName %
-				where.first %
-				(includeDeleted ? "" : QStringLiteral(" AND %1._deleted_ = 0").arg(tableName)),
+				plan.where() %
+				(includeDeleted ? "" : QStringLiteral(" AND %1._deleted_ = 0").arg(tableName)) %
+				m_checkpoint %
+				selection %
+				plan.order(),
 				m_db);
-	for (const QVariant &val : where.second) {
+	// rows are only ever visited once, this keeps the driver from buffering the entire result
+	sql.setForwardOnly(true);
+	for (const QVariant &val : plan.values()) {
 		sql.addBindValue(val);
 	}
 	Database::exec(sql);
 
-	QVector<Common::Record> records;
+	// map result columns to record slots once instead of comparing field names for every row
+	enum { Skip = -1, IdColumn = -2, RevisionColumn = -3 };
+	const QSqlRecord sqlRecord = sql.record();
+	const Common::TableSchema &schema = Common::tableSchema(query.table());
+	QVector<int> columns;
+	for (int i = 0; i < sqlRecord.count(); ++i) {
+		const QString name = sqlRecord.fieldName(i);
+		if (name == "id") {
+			columns.append(IdColumn);
+		} else if (name == "_latest_revision_") {
+			columns.append(RevisionColumn);
+		} else {
+			columns.append(schema.indexOf(name));
+		}
+	}
+
+	// values get the types of their fields, the same as records from the change log, from clients or resident tables
+	// have, instead of whatever the driver returns (integers for booleans or strings for dates in SQLite for example)
+	Common::BaseValidator *validator = Common::BaseValidator::getValidator(query.table());
+	const auto toFieldValue = [validator, &schema](const int index, const QVariant &value) {
+		if (value.isNull()) {
+			return QVariant();
+		}
+		try {
+			return Common::internValue(schema.field(index), validator->coerce(index, value));
+		} catch (Common::CoercionException &) {
+			return Common::internValue(schema.field(index), value);
+		}
+	};
+
+	int count = 0;
 	while (sql.next()) {
-		Common::Record record;
-		record.setTable(query.table());
-
-		const QSqlRecord sqlRecord = sql.record();
-		QHash<QString, QVariant> values;
-		for (int i = 0; i < sqlRecord.count(); ++i) {
-			if (sqlRecord.fieldName(i) == "id") {
-				record.setId(sqlRecord.value(i).value<Common::Id>());
-			} else if (sqlRecord.fieldName(i) == "_latest_revision_") {
-				record.setLatestRevision(sqlRecord.value(i).value<Common::Revision>());
-			} else if (!sqlRecord.fieldName(i).startsWith('_')) {
-				values.insert(sqlRecord.fieldName(i), sqlRecord.value(i));
+		Common::Record record(query.table());
+		for (int i = 0; i < columns.size(); ++i) {
+			switch (columns.at(i)) {
+			case Skip: break;
+			case IdColumn: record.setId(sql.value(i).value<Common::Id>()); break;
+			case RevisionColumn: record.setLatestRevision(sql.value(i).value<Common::Revision>()); break;
+			default: record.setValue(columns.at(i), toFieldValue(columns.at(i), sql.value(i))); break;
 			}
 		}
-		record.setValues(values);
 
-		record.setComplete(true);
-		records.append(record);
+		// projected records lack fields and must not end up in the cache
+		record.setComplete(!query.isProjected());
+		if (!includeDeleted && record.isComplete()) {
+			cacheInsert(record);
+		}
+		cb(record);
+		++count;
 	}
 
-	return records;
+	return count;
+}
+
+static void validateAggregate(const Common::AggregateQuery &query)
+{
+	const Common::TableQuery &tableQuery = query.query();
+	if (tableQuery.isProjected() || !tableQuery.sort().isEmpty() || tableQuery.limit() != 0 || !tableQuery.after().isEmpty()) {
+		throw ValidationException("Aggregates do not support projections, sorting or pagination");
+	}
+	if (query.aggregates().isEmpty()) {
+		throw ValidationException("No aggregates given");
+	}
+	const Common::TableSchema &schema = Common::tableSchema(tableQuery.table());
+	for (const QString &field : query.groupBy()) {
+		if (schema.indexOf(field) == -1) {
+			throw ValidationException(QStringLiteral("Unknown group by field '%1'") % field);
+		}
+	}
+	for (const Common::Aggregate &aggregate : query.aggregates()) {
+		if (aggregate.field().isEmpty()) {
+			if (aggregate.function() != Common::Aggregate::Count) {
+				throw ValidationException("Only counting does not need a field");
+			}
+			continue;
+		}
+		const int index = schema.indexOf(aggregate.field());
+		if (index == -1) {
+			throw ValidationException(QStringLiteral("Unknown aggregate field '%1'") % aggregate.field());
+		}
+		const Common::BaseValidator::FieldType type = schema.field(index).type;
+		if (aggregate.function() == Common::Aggregate::Sum
+				&& type != Common::BaseValidator::Integer && type != Common::BaseValidator::Real) {
+			throw ValidationException(QStringLiteral("Unable to sum non-numeric field '%1'") % aggregate.field());
+		}
+	}
+}
+
+Common::AggregateResult DatabaseEngine::aggregate(const Common::AggregateQuery &query)
+{
+	validateAggregate(query);
+	const QueryPlan plan(query.query(), m_db.driver());
+
+	const QString tableName = m_db.driver()->escapeIdentifier(Common::tableName(query.query().table()), QSqlDriver::TableName);
+	const auto column = [this, &tableName](const QString &field) {
+		return tableName + '.' + m_db.driver()->escapeIdentifier(field, QSqlDriver::FieldName);
+	};
+	QStringList keys;
+	for (const QString &field : query.groupBy()) {
+		keys.append(column(field));
+	}
+	QStringList selection = keys;
+	for (const Common::Aggregate &aggregate : query.aggregates()) {
+		const QString argument = aggregate.field().isEmpty() ? QStringLiteral("*") : column(aggregate.field());
+		switch (aggregate.function()) {
+		case Common::Aggregate::Count: selection.append("COUNT(" + argument + ')'); break;
+		case Common::Aggregate::Sum: selection.append("SUM(" + argument + ')'); break;
+		case Common::Aggregate::Min: selection.append("MIN(" + argument + ')'); break;
+		case Common::Aggregate::Max: selection.append("MAX(" + argument + ')'); break;
+		}
+	}
+	QString statement = QStringLiteral("SELECT %1 FROM %2 %3 AND %2._deleted_ = 0").arg(selection.join(", "), tableName, plan.where());
+	if (!keys.isEmpty()) {
+		statement += QStringLiteral(" GROUP BY %1 ORDER BY %1").arg(keys.join(", "));
+	}
+
+	// the revision is taken before reading so that any later change will trigger a recomputation
+	Common::AggregateResult result;
+	result.setQuery(query);
+	result.setRevision(m_latestRevision);
+
+	QSqlQuery sql = Database::prepare(statement, m_db);
+	sql.setForwardOnly(true);
+	for (const QVariant &val : plan.values()) {
+		sql.addBindValue(val);
+	}
+	Database::exec(sql);
+
+	const Common::TableSchema &schema = Common::tableSchema(query.query().table());
+	QVector<Common::AggregateGroup> groups;
+	while (sql.next()) {
+		QVector<QVariant> key;
+		for (int i = 0; i < keys.size(); ++i) {
+			key.append(Common::internValue(schema.field(schema.indexOf(query.groupBy().at(i))), sql.value(i)));
+		}
+		QVector<QVariant> values;
+		for (int i = 0; i < query.aggregates().size(); ++i) {
+			const QVariant value = sql.value(keys.size() + i);
+			values.append(query.aggregates().at(i).function() == Common::Aggregate::Count ? QVariant(value.toLongLong()) : value);
+		}
+		groups.append(Common::AggregateGroup(key, values));
+	}
+	result.setGroups(groups);
+	return result;
 }
 
 Common::Record DatabaseEngine::complete(const Common::Record &record)
@@ -301,8 +785,136 @@ Common::Record DatabaseEngine::complete(const Common::Record &record)
 	return read(record.table(), record.id());
 }
 
-Common::Revision DatabaseEngine::insertChange(const QString &table, const Common::Id id,
-											  const Common::Change::Type type, const Common::Record &record)
+QHash<Common::Table, Common::Revision> DatabaseEngine::tableRevisions() const
+{
+	QHash<Common::Table, Common::Revision> revisions;
+	for (const Common::Table table : recordTables) {
+		revisions.insert(table, tableRevision(table));
+	}
+	return revisions;
+}
+
+Common::Revision DatabaseEngine::queryRevision(const Common::TableQuery &query) const
+{
+	Common::Revision revision = 0;
+	for (const Common::Table table : queryTables(query)) {
+		revision = std::max(revision, tableRevision(table));
+	}
+	return revision;
+}
+
+Common::Revision DatabaseEngine::checkpoint(const qint64 before)
+{
+	const QString changeTable = m_db.driver()->escapeIdentifier(Common::tableName(Common::Table::Change), QSqlDriver::TableName);
+
+	// the newest change is always kept, to not lose track of the latest revision
+	QSqlQuery newest = Database::prepare(QStringLiteral("SELECT MAX(id) FROM %1 WHERE timestamp < ? AND id < (SELECT MAX(id) FROM %1)").arg(changeTable), m_db);
+	newest.addBindValue(before);
+
+	Database::TransactionLocker locker(m_db);
+	Database::exec(newest);
+	const Common::Revision revision = newest.next() ? newest.value(0).value<Common::Revision>() : 0;
+	if (revision <= m_checkpoint) {
+		return m_checkpoint;
+	}
+
+	// tombstones can only be purged as long as we still know when they were deleted
+	for (const Common::Table table : recordTables) {
+		QSqlQuery purge = Database::prepare(QStringLiteral("DELETE FROM %1 WHERE _deleted_ = 1 AND id IN "
+														   "(SELECT record_id FROM %2 WHERE record_table = ? AND type = 'D' AND id <= ?)")
+											.arg(m_db.driver()->escapeIdentifier(Common::tableName(table), QSqlDriver::TableName), changeTable),
+											m_db);
+		purge.addBindValue(Common::tableName(table));
+		purge.addBindValue(revision);
+		Database::exec(purge);
+	}
+
+	QSqlQuery trim = Database::prepare(QStringLiteral("DELETE FROM %1 WHERE id <= ?").arg(changeTable), m_db);
+	trim.addBindValue(revision);
+	Database::exec(trim);
+
+	Database::exec(m_db.exec("DELETE FROM meta WHERE key = 'checkpoint'"));
+	QSqlQuery store = Database::prepare("INSERT INTO meta (key, value) VALUES ('checkpoint', ?)", m_db);
+	store.addBindValue(QString::number(revision));
+	Database::exec(store);
+
+	locker.commit();
+
+	m_checkpoint = revision;
+	// cached records might now report an older revision than the checkpoint
+	resetInMemoryCopies();
+
+	// the trimmed changes and purged records would otherwise come back when replaying the journal
+	if (m_journal) {
+		compactJournal();
+	}
+	return m_checkpoint;
+}
+
+void DatabaseEngine::resetInMemoryCopies()
+{
+	for (const auto &cache : m_caches) {
+		cache->clear();
+	}
+	for (const Common::Table table : m_resident.keys()) {
+		setResident(table, false);
+		setResident(table, true);
+	}
+}
+
+void DatabaseEngine::compactJournal()
+{
+	m_journal->rewrite([this](const Journal::Writer &write) {
+		write(QJsonObject{{"checkpoint", Json::toJson(m_checkpoint)}});
+
+		// the current state of all records, including tombstones whose deletion is still in the change log
+		for (const Common::Table table : recordTables) {
+			if (table == Common::Table::Client) {
+				continue;
+			}
+			const QString tableName = m_db.driver()->escapeIdentifier(Common::tableName(table), QSqlDriver::TableName);
+			QSqlQuery deletedQuery = Database::prepare(QStringLiteral("SELECT id FROM %1 WHERE _deleted_ = 1") % tableName, m_db);
+			Database::exec(deletedQuery);
+			QSet<Common::Id> deleted;
+			while (deletedQuery.next()) {
+				deleted.insert(deletedQuery.value(0).value<Common::Id>());
+			}
+
+			findInDatabase(QueryPlan(Common::TableQuery(table), m_db.driver()), true, [&write, &deleted](const Common::Record &record) {
+				write(QJsonObject{
+						  {"type", "S"},
+						  {"table", Common::tableName(record.table())},
+						  {"id", Json::toJson(record.id())},
+						  {"deleted", deleted.contains(record.id())},
+						  {"data", Json::toJsonObject(record.values())}
+					  });
+			});
+		}
+
+		// followed by what is left of the change log, which the records above already reflect
+		QSqlQuery changes = Database::prepare(QStringLiteral("SELECT id,record_table,record_id,timestamp,fields,type,data FROM %1 WHERE record_table <> ? ORDER BY id ASC")
+											  % m_db.driver()->escapeIdentifier(Common::tableName(Common::Table::Change), QSqlDriver::TableName),
+											  m_db);
+		changes.setForwardOnly(true);
+		changes.addBindValue(Common::tableName(Common::Table::Client));
+		Database::exec(changes);
+		while (changes.next()) {
+			write(QJsonObject{
+					  {"revision", Json::toJson(changes.value(0).value<Common::Revision>())},
+					  {"timestamp", QJsonValue(changes.value(3).toLongLong())},
+					  {"table", changes.value(1).toString()},
+					  {"id", Json::toJson(changes.value(2).value<Common::Id>())},
+					  {"type", changes.value(5).toString()},
+					  {"fields", changes.isNull(4) ? QJsonValue() : QJsonValue(changes.value(4).toString())},
+					  {"data", changes.isNull(6) ? QJsonObject() : Json::ensureObject(Json::ensureDocument(changes.value(6).toByteArray()))},
+					  {"applied", true}
+				  });
+		}
+	});
+}
+
+DatabaseEngine::RecordedChange DatabaseEngine::insertChange(const QString &table, const Common::Id id,
+															const Common::Change::Type type, const Common::Record &record)
 {
 	QChar typeChar;
 	switch (type) {
@@ -311,35 +923,261 @@ Common::Revision DatabaseEngine::insertChange(const QString &table, const Common
 	case Sportsed::Common::Change::Delete: typeChar = 'D'; break;
 	}
 
-	QSqlQuery query = Database::prepare("INSERT INTO %1 (record_table, record_id, timestamp, fields, type) VALUES (?,?,?,?,?)"
+	// the full post-image is stored with the change, which allows changes() to answer without touching the record tables
+	cacheRemove(record.table(), id);
+	Common::Record postImage = record;
+	if (!postImage.isComplete()) {
+		// bypasses the resident copy, which is not updated until the change is committed. includes deleted records only
+		// to keep the uncommitted row out of the cache
+		const QueryPlan plan(Common::TableQuery(record.table(), Common::TableFilter("id", id)), m_db.driver());
+		const QVector<Common::Record> rows = findInDatabase(plan, true);
+		if (rows.isEmpty()) {
+			throw Database::DoesntExistException();
+		}
+		postImage = rows.first();
+	}
+	const QJsonObject data = Json::toJsonObject(postImage.values());
+
+	const qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+	const QVariant fields = !record.hasValues() || type != Common::Change::Type::Update
+			? QVariant(QVariant::String)
+			: QVariant(QList<QString>::fromVector(record.fields()).join(','));
+
+	QSqlQuery query = Database::prepare("INSERT INTO %1 (record_table, record_id, timestamp, fields, type, data) VALUES (?,?,?,?,?,?)"
 										% Common::tableName(Common::Table::Change), m_db);
 	query.addBindValue(table);
 	query.addBindValue(id);
-	query.addBindValue(QDateTime::currentMSecsSinceEpoch());
-	if (record.values().isEmpty() || type != Common::Change::Type::Update) {
-		query.addBindValue(QVariant(QVariant::String));
-	} else {
-		query.addBindValue(record.values().keys().join(','));
-	}
+	query.addBindValue(timestamp);
+	query.addBindValue(fields);
 	query.addBindValue(typeChar);
+	query.addBindValue(encodePostImage(data));
 	Database::exec(query);
 
 	Common::Change change{type};
 	change.setRevision(query.lastInsertId().value<Common::Revision>());
-	change.setRecord(complete(record));
+	postImage.setLatestRevision(change.revision());
+	change.setRecord(postImage);
 	if (type == Common::Change::Type::Update) {
-		change.setUpdatedFields(record.values().keys().toVector());
+		change.setUpdatedFields(record.fields());
+	}
+
+	// the journal entry is only written once the transaction has been committed, see applyChange()
+	RecordedChange recorded{change, QJsonObject()};
+	// clients are removed on startup anyway, so there is no point in keeping them around
+	if (m_journal && record.table() != Common::Table::Client) {
+		recorded.journalEntry = QJsonObject{
+				{"revision", Json::toJson(change.revision())},
+				{"timestamp", QJsonValue(timestamp)},
+				{"table", table},
+				{"id", Json::toJson(id)},
+				{"type", QString(typeChar)},
+				{"fields", fields.isNull() ? QJsonValue() : QJsonValue(fields.toString())},
+				{"data", data}
+		};
+	}
+	return recorded;
+}
+
+void DatabaseEngine::applyChange(const RecordedChange &recorded)
+{
+	if (m_journal && !recorded.journalEntry.isEmpty()) {
+		m_journal->append(recorded.journalEntry);
+	}
+
+	const Common::Change &change = recorded.change;
+	const Common::Record &record = change.record();
+	m_tableRevisions.insert(record.table(), change.revision());
+	m_latestRevision = change.revision();
+	if (change.type() == Common::Change::Delete) {
+		cacheRemove(record.table(), record.id());
+		residentRemove(record.table(), record.id());
+	} else {
+		cacheInsert(record);
+		residentUpsert(record);
 	}
 	if (m_changeCb) {
 		m_changeCb(change);
 	}
+}
+
+int DatabaseEngine::replay(const EntryReader &next)
+{
+	QHash<Common::Table, Common::Revision> tableRevisions;
+	Common::Revision checkpoint = m_checkpoint;
+
+	int count = 0;
+	Database::TransactionLocker locker(m_db);
+	QJsonObject entry;
+	while (next(entry)) {
+		if (entry.contains("checkpoint")) {
+			checkpoint = Json::ensureIsType<Common::Revision>(entry, "checkpoint");
+			Database::exec(m_db.exec("DELETE FROM meta WHERE key = 'checkpoint'"));
+			QSqlQuery store = Database::prepare("INSERT INTO meta (key, value) VALUES ('checkpoint', ?)", m_db);
+			store.addBindValue(QString::number(checkpoint));
+			Database::exec(store);
+		} else {
+			const Common::Revision revision = replayEntry(entry);
+			if (revision != 0) {
+				tableRevisions.insert(Common::fromTableName(Json::ensureString(entry, "table")), revision);
+			}
+		}
+		++count;
+	}
+	locker.commit();
+
+	m_checkpoint = checkpoint;
+	for (auto it = tableRevisions.constBegin(); it != tableRevisions.constEnd(); ++it) {
+		m_tableRevisions.insert(it.key(), it.value());
+		m_latestRevision = std::max(m_latestRevision, it.value());
+	}
+	m_latestRevision = std::max(m_latestRevision, m_checkpoint);
+	resetInMemoryCopies();
+	return count;
+}
+
+Common::Revision DatabaseEngine::replayEntry(const QJsonObject &entry)
+{
+	const Common::Table table = Common::fromTableName(Json::ensureString(entry, "table"));
+	const Common::Id id = Json::ensureIsType<Common::Id>(entry, "id");
+	const QString type = Json::ensureString(entry, "type");
+	const QJsonObject data = Json::ensureObject(entry, "data");
+	const Common::Revision revision = type == "S" ? 0 : Json::ensureIsType<Common::Revision>(entry, "revision");
+	const Common::Record record = decodePostImage(table, id, revision, data);
+
+	const QString tableName = m_db.driver()->escapeIdentifier(Common::tableName(table), QSqlDriver::TableName);
+	QStringList fields;
+	QStringList placeholders;
+	QVector<QVariant> values;
+	for (const QString &field : record.fields()) {
+		fields.append(m_db.driver()->escapeIdentifier(field, QSqlDriver::FieldName));
+		placeholders.append("?");
+		values.append(record.value(field));
+	}
+
+	// the post-image is applied as a whole, which makes replaying independent of what the original change contained.
+	// changes written while compacting the journal are already reflected by the records written before them
+	if (!entry.value("applied").toBool()) {
+		QSqlQuery query;
+		if (type == "C" || type == "S") {
+			query = Database::prepare(QStringLiteral("INSERT INTO %1 (id, _deleted_%2) VALUES (?, ?%3)")
+									  % tableName
+									  % (fields.isEmpty() ? QString() : ',' + fields.join(','))
+									  % (placeholders.isEmpty() ? QString() : ',' + placeholders.join(',')),
+									  m_db);
+			query.addBindValue(id);
+			query.addBindValue(entry.value("deleted").toBool() ? 1 : 0);
+			for (const QVariant &value : values) {
+				query.addBindValue(value);
+			}
+		} else if (type == "U") {
+			query = Database::prepare(QStringLiteral("UPDATE %1 SET %2 = ? WHERE id = ?")
+									  % tableName
+									  % fields.join(" = ?,"),
+									  m_db);
+			for (const QVariant &value : values) {
+				query.addBindValue(value);
+			}
+			query.addBindValue(id);
+		} else if (type == "D") {
+			query = Database::prepare(QStringLiteral("UPDATE %1 SET _deleted_ = 1 WHERE id = ?") % tableName, m_db);
+			query.addBindValue(id);
+		} else {
+			throw Database::DatabaseException("Unknown change type '%1'" % type);
+		}
+		Database::exec(query);
+	}
+	if (type == "S") {
+		return 0;
+	}
+
+	QSqlQuery change = Database::prepare("INSERT INTO %1 (id, record_table, record_id, timestamp, fields, type, data) VALUES (?,?,?,?,?,?,?)"
+										 % Common::tableName(Common::Table::Change), m_db);
+	change.addBindValue(revision);
+	change.addBindValue(Common::tableName(table));
+	change.addBindValue(id);
+	change.addBindValue(static_cast<qint64>(entry.value("timestamp").toDouble()));
+	change.addBindValue(entry.value("fields").isString() ? QVariant(entry.value("fields").toString()) : QVariant(QVariant::String));
+	change.addBindValue(type);
+	change.addBindValue(encodePostImage(data));
+	Database::exec(change);
+	return revision;
+}
+
+void DatabaseEngine::setCacheLimit(const Common::Table table, const int maxRecords)
+{
+	if (maxRecords <= 0) {
+		m_caches.remove(table);
+	} else if (m_caches.contains(table)) {
+		m_caches.value(table)->setMaxCost(maxRecords);
+	} else {
+		m_caches.insert(table, std::make_shared<QCache<Common::Id, Common::Record>>(maxRecords));
+	}
+}
+
+void DatabaseEngine::cacheInsert(const Common::Record &record)
+{
+	if (m_caches.contains(record.table())) {
+		m_caches.value(record.table())->insert(record.id(), new Common::Record(record));
+	}
+}
+void DatabaseEngine::cacheRemove(const Common::Table table, const Common::Id id)
+{
+	if (m_caches.contains(table)) {
+		m_caches.value(table)->remove(id);
+	}
+}
 
-	return change.revision();
+void DatabaseEngine::setResident(const Common::Table table, const bool resident)
+{
+	if (!resident) {
+		m_resident.remove(table);
+		return;
+	}
+	if (m_resident.contains(table)) {
+		return;
+	}
+
+	auto store = std::make_shared<ColumnStore>(table);
+	store->setBinaryStrings(m_binaryStrings);
+	try {
+		for (const Common::Record &record : findInDatabase(QueryPlan(Common::TableQuery(table), m_db.driver()))) {
+			store->upsert(record);
+		}
+	} catch (Common::CoercionException &e) {
+		qCCritical(engine) << "unable to keep" << Common::tableName(table) << "in memory:" << e.cause();
+		return;
+	}
+	m_resident.insert(table, store);
+}
+
+void DatabaseEngine::setAllResident()
+{
+	for (const Common::Table table : recordTables) {
+		setResident(table, true);
+	}
+}
+
+void DatabaseEngine::residentUpsert(const Common::Record &record)
+{
+	if (m_resident.contains(record.table())) {
+		try {
+			m_resident.value(record.table())->upsert(record);
+		} catch (Common::CoercionException &e) {
+			qCCritical(engine) << "unable to keep" << Common::tableName(record.table()) << "in memory:" << e.cause();
+			m_resident.remove(record.table());
+		}
+	}
+}
+void DatabaseEngine::residentRemove(const Common::Table table, const Common::Id id)
+{
+	if (m_resident.contains(table)) {
+		m_resident.value(table)->remove(id);
+	}
 }
 
 void DatabaseEngine::validateValues(const Common::Record &record, const QSqlRecord &sqlRecord, const bool strict)
 {
-	if (record.values().contains("id")) {
+	if (record.hasValue("id")) {
 		throw ValidationException("Attempting to explicitly set ID field");
 	}
 
@@ -348,14 +1186,14 @@ void DatabaseEngine::validateValues(const Common::Record &record, const QSqlReco
 		if (field.name().startsWith('_')) {
 			continue;
 		}
-		if (field.isAutoValue() && record.values().contains(field.name())) {
+		if (field.isAutoValue() && record.hasValue(field.name())) {
 			throw ValidationException(QStringLiteral("Attempting to explicitly set auto-valued field '%1'") % field.name());
-		} else if (field.requiredStatus() == QSqlField::Required && !record.values().contains(field.name()) && strict) {
+		} else if (field.requiredStatus() == QSqlField::Required && !record.hasValue(field.name()) && strict) {
 			throw ValidationException(QStringLiteral("Missing required field '%1'") % field.name());
 		}
 	}
 
-	for (const QString &name : record.values().keys()) {
+	for (const QString &name : record.fields()) {
 		if (!sqlRecord.contains(name)) {
 			throw ValidationException(QStringLiteral("Attempting to set non-existent field '%1'") % name);
 		}
@@ -1,18 +1,29 @@
 #pragma once
 
 #include <QSqlDatabase>
+#include <QCache>
+#include <QLoggingCategory>
+#include <algorithm>
+#include <memory>
 
 #include <jd-util/Exception.h>
 #include <jd-util-sql/DatabaseUtil.h>
 
+#include "commonlib/AggregateQuery.h"
 #include "commonlib/ChangeQuery.h"
 #include "commonlib/ChangeResponse.h"
 #include "commonlib/Record.h"
+#include "commonlib/Snapshot.h"
+#include "ColumnStore.h"
+#include "QueryPlan.h"
 
 namespace Sportsed {
 namespace Server {
 
-DECLARE_EXCEPTION(Validation)
+class Journal;
+
+Q_DECLARE_LOGGING_CATEGORY(engine)
+DECLARE_EXCEPTION(Conflict)
 
 class DatabaseEngine
 {
@@ -22,23 +33,121 @@ public:
 	Common::ChangeResponse changes(const Common::ChangeQuery &query);
 
 	Common::Record create(const Common::Record &record);
-	Common::Record read(const Common::Table &table, const Common::Id id, const bool includeDeleted = false);
-	Common::Revision update(const Common::Record &record);
-	Common::Revision delete_(const Common::Table &table, const Common::Id id);
+	/// Reads a single record, reduced to the given fields if any are given
+	Common::Record read(const Common::Table &table, const Common::Id id, const bool includeDeleted = false,
+						const QVector<QString> &fields = {});
+	/// Reads all given records at once, in the given order and with null records for the ones that do not exist
+	QVector<Common::Record> readMany(const Common::Table &table, const QVector<Common::Id> &ids);
+	/// Like read(), but only returns the record if it has changed after the given revision
+	Common::ConditionalResult readIfModified(const Common::Table &table, const Common::Id id, const Common::Revision since);
+	/// Applies the values of the record. If an expected revision is given the record is only updated if it is still of
+	/// that revision, a ConflictException is thrown otherwise
+	Common::Revision update(const Common::Record &record, const std::optional<Common::Revision> &expectedRevision = {});
+	/// Deletes the record, only if it is still of the expected revision if one is given, see update()
+	Common::Revision delete_(const Common::Table &table, const Common::Id id,
+							 const std::optional<Common::Revision> &expectedRevision = {});
 
 	QVector<Common::Record> find(const Common::TableQuery &query, const bool includeDeleted = false);
+	QVector<Common::Record> find(const QueryPlan &plan, const bool includeDeleted = false);
+	/// Like find(), but only returns the records if the result may have changed after the given revision
+	Common::ConditionalResult findIfModified(const Common::TableQuery &query, const Common::Revision since);
+	/// Like find(), but also returns the records referenced through the includes of the query
+	Common::FindResult findIncluding(const Common::TableQuery &query);
+	/// Finds the records of all queries at the same revision
+	Common::Snapshot snapshot(const QVector<Common::TableQuery> &queries);
+	using RecordCallback = std::function<void(const Common::Record &)>;
+	/// Like find(), but hands each record to the callback as soon as it has been read instead of collecting them all,
+	/// returns the number of records found
+	int findStreamed(const Common::TableQuery &query, const RecordCallback &cb, const bool includeDeleted = false);
+	int findStreamed(const QueryPlan &plan, const RecordCallback &cb, const bool includeDeleted = false);
+
+	/// Computes the aggregates in the database, throws a ValidationException for unknown fields or unsupported queries
+	Common::AggregateResult aggregate(const Common::AggregateQuery &query);
 
 	Common::Record complete(const Common::Record &record);
 
+	/// Trims the change log up to the newest change made before the given timestamp (ms since epoch) and purges the
+	/// deleted records of that range, returns the new checkpoint revision
+	Common::Revision checkpoint(const qint64 before);
+	Common::Revision checkpointRevision() const { return m_checkpoint; }
+
+	Common::Revision latestRevision() const { return m_latestRevision; }
+	/// No change has been made to the given table after the returned revision
+	Common::Revision tableRevision(const Common::Table table) const { return std::max(m_tableRevisions.value(table), m_checkpoint); }
+	QHash<Common::Table, Common::Revision> tableRevisions() const;
+	/// No change that may affect the result of the query has been made after the returned revision, this includes
+	/// changes to the tables of referenced records that are filtered on or included
+	Common::Revision queryRevision(const Common::TableQuery &query) const;
+
+	/// Keeps up to maxRecords records of the given table in memory, 0 disables caching of the table
+	void setCacheLimit(const Common::Table table, const int maxRecords);
+	quint64 cacheHits() const { return m_cacheHits; }
+	quint64 cacheMisses() const { return m_cacheMisses; }
+
+	/// Keeps a column-wise copy of the table in memory that read() and find() are answered from where possible
+	void setResident(const Common::Table table, const bool resident);
+	/// Keeps all tables resident, for databases that live in memory anyway
+	void setAllResident();
+	bool isResident(const Common::Table table) const { return m_resident.contains(table); }
+
+	/// Appends all changes to the given journal from now on, pass nullptr to stop journaling
+	void setJournal(Journal *journal) { m_journal = journal; }
+	/// Returns false once there are no more entries
+	using EntryReader = std::function<bool(QJsonObject &entry)>;
+	/// Applies the entries read from a journal in a single transaction, changes keep their revision and record id.
+	/// Returns the number of entries applied
+	int replay(const EntryReader &next);
+
 	using ChangeCallback = std::function<void(Common::Change)>;
 	void setChangeCallback(const ChangeCallback &cb) { m_changeCb = cb; }
 
 private:
 	QSqlDatabase m_db;
 	ChangeCallback m_changeCb;
+	Journal *m_journal = nullptr;
+	/// Changes up to and including this revision have been removed from the change log
+	Common::Revision m_checkpoint = 0;
+	Common::Revision m_latestRevision = 0;
+	QHash<Common::Table, Common::Revision> m_tableRevisions;
+
+	/// Write-through cache of complete, non-deleted records
+	QHash<Common::Table, std::shared_ptr<QCache<Common::Id, Common::Record>>> m_caches;
+	quint64 m_cacheHits = 0;
+	quint64 m_cacheMisses = 0;
+	void cacheInsert(const Common::Record &record);
+	void cacheRemove(const Common::Table table, const Common::Id id);
+
+	QHash<Common::Table, std::shared_ptr<RecordStore>> m_resident;
+	/// Whether the database compares strings like QString does, see ColumnStore::setBinaryStrings()
+	bool m_binaryStrings = true;
+	/// Whether sorting the query in memory gives the same order as the database
+	bool canOrderInMemory(const Common::TableQuery &query) const;
+	void residentUpsert(const Common::Record &record);
+	void residentRemove(const Common::Table table, const Common::Id id);
+
+	/// Drops the cached and resident records, which are then read from the database again
+	void resetInMemoryCopies();
+	/// Rewrites the journal to the current records followed by the remaining change log
+	void compactJournal();
+	/// Returns the revision of the replayed change, 0 for the records written by compactJournal()
+	Common::Revision replayEntry(const QJsonObject &entry);
+
+	/// Finds the records with the given ids, in batches for long lists of ids
+	QVector<Common::Record> findByIds(const Common::Table table, const QVariantList &ids);
+	QVector<Common::Record> findInDatabase(const QueryPlan &plan, const bool includeDeleted = false);
+	int findInDatabase(const QueryPlan &plan, const bool includeDeleted, const RecordCallback &cb);
 
-	Common::Revision insertChange(const QString &table, const Common::Id id,
-								  const Common::Change::Type type, const Common::Record &record);
+	struct RecordedChange
+	{
+		Common::Change change;
+		/// Empty if the change is not journaled
+		QJsonObject journalEntry;
+	};
+	/// Records the change in the change log, applyChange() has to follow once the surrounding transaction is committed
+	RecordedChange insertChange(const QString &table, const Common::Id id,
+								const Common::Change::Type type, const Common::Record &record);
+	/// Journals the committed change, updates the caches and revisions and notifies about it
+	void applyChange(const RecordedChange &recorded);
 	void validateValues(const Common::Record &record, const QSqlRecord &sqlRecord, const bool strict);
 };
 
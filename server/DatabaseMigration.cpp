@@ -3,27 +3,21 @@
 #include <QSqlDatabase>
 #include <QSqlRecord>
 #include <QSqlQuery>
+#include <QSqlDriver>
 #include <QVector>
 #include <QVariant>
 #include <QDebug>
 
 #include <jd-util-sql/DatabaseUtil.h>
-#include <jd-util/Functional.h>
 #include <jd-util/TermUtil.h>
 
+#include "commonlib/Schema.h"
+
 using namespace JD::Util;
 
 namespace Sportsed {
 namespace Server {
 
-struct Table
-{
-	template <typename... Fields>
-	explicit Table(const QString &name, Fields... fields)
-		: sql("CREATE TABLE %1 (__id__, _deleted_ BOOLEAN NOT NULL DEFAULT 0, %2)" % name % QStringList({fields...}).join(", ").replace("FK", "__fk__")) {}
-	QString sql;
-};
-
 static QVector<QString> createStatements(QSqlDatabase &db)
 {
 	Database::Dialect dialect(db);
@@ -31,45 +25,15 @@ static QVector<QString> createStatements(QSqlDatabase &db)
 	const QString idField = dialect.idField(Database::Dialect::Big);
 	const QString fkFieldType = dialect.fkFieldType(Database::Dialect::Big);
 
-	const QVector<Table> tables = {
-		Table("meta", "key VARCHAR(64) NOT NULL", "value VARCHAR(256)"),
-		Table("change", "type CHAR(1) NOT NULL", "record_id INT NOT NULL", "record_table VARCHAR(32) NOT NULL",
-			  "timestamp INT NOT NULL", "fields VARCHAR(256) DEFAULT NULL"),
-		Table("profile", "type VARCHAR(16) NOT NULL", "name VARCHAR(64) NOT NULL", "value TEXT NOT NULL"),
-		Table("client", "name VARCHAR(64) NOT NULL", "ip VARCHAR(32) NOT NULL"),
-		Table("competition", "name VARCHAR(128) NOT NULL", "sport VARCHAR(64) NOT NULL"),
-		Table("stage", "competition_id FK NOT NULL", "name VARCHAR(128) NOT NULL", "type VARCHAR(64) NOT NULL", "discipline VARCHAR(64) NOT NULL", "date DATE NOT NULL", "in_totals BOOLEAN NOT NULL DEFAULT TRUE"),
-		Table("control", "stage_id FK", "name VARCHAR(5) NOT NULL", "special VARCHAR(256) NOT NULL DEFAULT ''"),
-		Table("course", "stage_id FK", "name VARCHAR(64) NOT NULL"),
-		Table("course_control", "control_id FK", "course_id FK", "'order' INTEGER NOT NULL", "distance_from_previous DOUBLE"),
-		Table("class", "stage_id FK", "name VARCHAR(64)")
-	};
-
-	return Functional::collection(tables).map([idField, fkFieldType](const Table &t) {
-		return QString(t.sql).replace("__id__", idField).replace("__fk__", fkFieldType);
-	});
-}
-static QVector<QString> extractFields(const QString &statement)
-{
-	QVector<QString> fields;
-	const int firstParan = statement.indexOf('(');
-	fields.append(statement.mid(firstParan+1, statement.indexOf(' ', firstParan)-firstParan).trimmed());
-
-	int index = 0;
-	while (index < statement.size()) {
-		const int nextComma = statement.indexOf(',', index);
-		if (nextComma == -1) {
-			break;
-		}
-		const int nextSpace = statement.indexOf(' ', nextComma+2);
-		const QString field = statement.mid(nextComma+1, nextSpace - nextComma).remove('\'').trimmed();
-		if (!field.startsWith('_')) {
-			fields.append(field);
+	QVector<QString> statements;
+	for (const Common::TableSchema *table = Common::tableSchemasBegin(); table != Common::tableSchemasEnd(); ++table) {
+		QStringList fields;
+		for (const Common::FieldSchema &field : *table) {
+			fields.append(db.driver()->escapeIdentifier(field.name, QSqlDriver::FieldName) + ' ' + QString(field.sql).replace("FK", fkFieldType));
 		}
-		index = nextSpace;
+		statements.append(QStringLiteral("CREATE TABLE %1 (%2, _deleted_ BOOLEAN NOT NULL DEFAULT 0, %3)") % table->name % idField % fields.join(", "));
 	}
-
-	return fields;
+	return statements;
 }
 
 void DatabaseMigration::create(QSqlDatabase &db)
@@ -87,19 +51,19 @@ void DatabaseMigration::create(QSqlDatabase &db)
 
 void DatabaseMigration::check(QSqlDatabase &db)
 {
-	const int preambleSize = QStringLiteral("CREATE TABLE ").size();
-
 	const QStringList tables = db.tables();
-	for (const QString &statement : createStatements(db)) {
-		const QString name = statement.mid(preambleSize, statement.indexOf(' ', preambleSize+1) - preambleSize).trimmed();
+	for (const Common::TableSchema *table = Common::tableSchemasBegin(); table != Common::tableSchemasEnd(); ++table) {
+		const QString name = table->name;
 		if (!tables.contains(name)) {
 			throw DatabaseCheckException("Missing table '%1'" % name);
 		}
 		const QSqlRecord record = db.record(name);
-		const QVector<QString> fields = extractFields(statement);
-		for (const QString &field : fields) {
-			if (!record.contains(field)) {
-				throw DatabaseCheckException("Table '%1' is missing the following field: '%2'" % name % field);
+		if (!record.contains("id")) {
+			throw DatabaseCheckException("Table '%1' is missing the following field: 'id'" % name);
+		}
+		for (const Common::FieldSchema &field : *table) {
+			if (!record.contains(field.name)) {
+				throw DatabaseCheckException("Table '%1' is missing the following field: '%2'" % name % field.name);
 			}
 		}
 	}
@@ -115,6 +79,11 @@ void DatabaseMigration::upgrade(QSqlDatabase &db)
 		return;
 	}
 
+	if (from < 2) {
+		// post-images of changed records, older changes are left as NULL
+		Database::exec(db.exec("ALTER TABLE change ADD COLUMN data TEXT DEFAULT NULL"));
+	}
+
 	Database::exec(db.exec(QStringLiteral("UPDATE meta SET value = %1 WHERE key = 'version'") % latestVersion()));
 
 	locker.commit();
@@ -130,7 +99,7 @@ int16_t DatabaseMigration::currentVersion(QSqlDatabase &db)
 
 int DatabaseMigration::latestVersion()
 {
-	return 1;
+	return 2;
 }
 
 void DatabaseMigration::prepare(QSqlDatabase &db, const bool forceMigrate)
@@ -2,12 +2,17 @@
 
 #include <QTcpSocket>
 #include <QLocalSocket>
+#include <QDateTime>
+#include <QJsonArray>
+#include <algorithm>
 
 #include <jd-util/Json.h>
 
+#include "commonlib/AggregateQuery.h"
 #include "commonlib/ChangeQuery.h"
 #include "commonlib/ChangeResponse.h"
 #include "commonlib/MessageSocket.h"
+#include "commonlib/Schema.h"
 #include "DatabaseMigration.h"
 
 using namespace JD::Util;
@@ -16,6 +21,17 @@ namespace Sportsed {
 namespace Server {
 Q_LOGGING_CATEGORY(server, "sportsed.server.server")
 
+struct Subscription
+{
+	Common::ChangeQuery query;
+	QueryPlan plan; // compiled once instead of for every change
+};
+struct AggregateSubscription
+{
+	Common::AggregateQuery query;
+	QJsonArray groups; // as last sent, recomputed results are only pushed if they differ
+};
+
 class Connection : public QObject
 {
 	Q_OBJECT
@@ -33,13 +49,29 @@ public:
 
 	Common::MessageSocket *socket;
 
-	QHash<int, Common::ChangeQuery> subscriptions;
+	QHash<int, Subscription> subscriptions;
+	QHash<int, AggregateSubscription> aggregateSubscriptions;
 	int nextSubscriptionId = 1;
 
+	/// ID of the message currently being handled, for commands that send partial replies
+	int currentMsgId = -1;
+
 	virtual void send(const QByteArray &msg)
 	{
 		socket->send(msg);
 	}
+	/// Hands as much of the written data to the operating system as possible without blocking
+	virtual void flush() {}
+	/// Sends a partial reply to the current message, to be followed by a regular reply
+	void sendChunk(const QJsonValue &data)
+	{
+		send(Json::toText(QJsonObject({
+										  {"cmd", "chunk"},
+										  {"data", data},
+										  {"reply_to", currentMsgId}
+									  })));
+		flush();
+	}
 	virtual QString address() const = 0;
 
 	Common::Record asClientRecord() const
@@ -77,6 +109,7 @@ public:
 	}
 
 	QString address() const override { return tcpSocket->peerAddress().toString(); }
+	void flush() override { tcpSocket->flush(); }
 
 	QTcpSocket *tcpSocket;
 };
@@ -103,6 +136,7 @@ public:
 	}
 
 	QString address() const override { return tr("local"); }
+	void flush() override { localSocket->flush(); }
 
 	QLocalSocket *localSocket;
 };
@@ -124,11 +158,50 @@ public:
 	QString address() const override { return tr("Embedded"); }
 };
 
+/// Foreign key path from records of the table to the competition they belong to, like "stage_id>competition_id", null
+/// for tables that do not belong to a competition
+static QString competitionPath(const Common::Table table)
+{
+	for (const Common::FieldSchema &field : Common::tableSchema(table)) {
+		const QString name = QString::fromLatin1(field.name);
+		if (field.type != Common::BaseValidator::ID || !name.endsWith("_id")) {
+			continue;
+		}
+		Common::Table target;
+		try {
+			target = referencedTable(table, name);
+		} catch (ValidationException &) {
+			continue;
+		}
+		if (target == Common::Table::Competition) {
+			return name;
+		}
+		const QString rest = competitionPath(target);
+		if (!rest.isNull()) {
+			return name + '>' + rest;
+		}
+	}
+	return QString();
+}
+
+/// Updates and deletes are only applied if the record is still of the revision given as "expected_revision", if any
+static std::optional<Common::Revision> expectedRevision(const QJsonObject &obj)
+{
+	if (!obj.contains("expected_revision")) {
+		return {};
+	}
+	return Json::ensureIsType<Common::Revision>(obj, "expected_revision");
+}
+
 DatabaseServer::DatabaseServer(QSqlDatabase &db, const QString &password)
 	: m_db(db), m_password(password), m_engine(db)
 {
 	m_engine.setChangeCallback([this](const Common::Change &change) { handleChange(change); });
 
+	m_aggregateTimer.setSingleShot(true);
+	m_aggregateTimer.setInterval(50);
+	QObject::connect(&m_aggregateTimer, &QTimer::timeout, [this]() { updateAggregates(); });
+
 	m_commands.insert("version", [this](QJsonValue, DatabaseEngine &, Connection *) -> QJsonValue {
 		return DatabaseMigration::currentVersion(m_db);
 	});
@@ -136,6 +209,17 @@ DatabaseServer::DatabaseServer(QSqlDatabase &db, const QString &password)
 		const Common::ChangeQuery query = Json::ensureIsType<Common::ChangeQuery>(data);
 		return engine.changes(query).toJson();
 	});
+	m_commands.insert("revisions", [](const QJsonValue &, DatabaseEngine &engine, Connection *) {
+		const QHash<Common::Table, Common::Revision> revisions = engine.tableRevisions();
+		QJsonObject tables;
+		for (auto it = revisions.constBegin(); it != revisions.constEnd(); ++it) {
+			tables.insert(Common::tableName(it.key()), Json::toJson(it.value()));
+		}
+		return QJsonObject({
+							   {"latest", Json::toJson(engine.latestRevision())},
+							   {"tables", tables}
+						   });
+	});
 	m_commands.insert("create", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) {
 		const Common::Record record = Json::ensureIsType<Common::Record>(data);
 		const Common::Record inserted = engine.create(record);
@@ -143,47 +227,136 @@ DatabaseServer::DatabaseServer(QSqlDatabase &db, const QString &password)
 	});
 	m_commands.insert("read", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) {
 		const QJsonObject obj = Json::ensureObject(data);
+		if (obj.contains("if_revision")) {
+			return engine.readIfModified(
+						Common::fromTableName(Json::ensureString(obj, "table")),
+						Json::ensureIsType<Common::Id>(obj, "id"),
+						Json::ensureIsType<Common::Revision>(obj, "if_revision")
+						).toJson();
+		}
 		const Common::Record record = engine.read(
 					Common::fromTableName(Json::ensureString(obj, "table")),
-					Json::ensureIsType<Common::Id>(obj, "id")
+					Json::ensureIsType<Common::Id>(obj, "id"),
+					false,
+					obj.contains("fields") ? Json::ensureIsArrayOf<QString>(obj, "fields") : QVector<QString>()
 					);
 		return record.toJson();
 	});
+	m_commands.insert("read_many", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) {
+		const QJsonObject obj = Json::ensureObject(data);
+		const QVector<Common::Record> records = engine.readMany(
+					Common::fromTableName(Json::ensureString(obj, "table")),
+					Json::ensureIsArrayOf<Common::Id>(obj, "ids")
+					);
+		return Common::RecordBatch(records).toJson();
+	});
 	m_commands.insert("update", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) {
-		const Common::Record record = Json::ensureIsType<Common::Record>(data);
-		const Common::Revision revision = engine.update(record);
+		const QJsonObject obj = Json::ensureObject(data);
+		const Common::Record record = Json::ensureIsType<Common::Record>(obj);
+		const Common::Revision revision = engine.update(record, expectedRevision(obj));
 		return Json::toJson(revision);
 	});
 	m_commands.insert("delete", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) {
 		const QJsonObject obj = Json::ensureObject(data);
 		const Common::Revision revision = engine.delete_(
 					Common::fromTableName(Json::ensureString(obj, "table")),
-					Json::ensureIsType<Common::Id>(obj, "id")
+					Json::ensureIsType<Common::Id>(obj, "id"),
+					expectedRevision(obj)
 					);
 		return Json::toJson(revision);
 	});
-	m_commands.insert("find", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) {
-		const Common::TableQuery query = Json::ensureIsType<Common::TableQuery>(data);
+	m_commands.insert("find", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) -> QJsonValue {
+		const QJsonObject obj = Json::ensureObject(data);
+		const Common::TableQuery query = Json::ensureIsType<Common::TableQuery>(obj);
+		// asking for includes, even none, changes the reply from an array of records to a FindResult, and so does a
+		// revision to a ConditionalResult
+		if (obj.contains("if_revision")) {
+			if (obj.contains("include")) {
+				throw Exception("Conditional finds do not support includes");
+			}
+			return engine.findIfModified(query, Json::ensureIsType<Common::Revision>(obj, "if_revision")).toJson();
+		} else if (obj.contains("include")) {
+			return engine.findIncluding(query).toJson();
+		}
 		return Json::toJsonArray(engine.find(query));
 	});
+	m_commands.insert("find_streamed", [](const QJsonValue &data, DatabaseEngine &engine, Connection *conn) {
+		const QJsonObject obj = Json::ensureObject(data);
+		const Common::TableQuery query = Json::ensureIsType<Common::TableQuery>(obj, "query");
+		const int chunkSize = obj.contains("chunk_size") ? Json::ensureInteger(obj, "chunk_size") : 256;
+		if (chunkSize < 1) {
+			throw Exception("Invalid chunk size");
+		}
+
+		// the revision is taken before reading so that subscribing from it will not miss any change
+		const Common::Revision revision = engine.latestRevision();
+		QJsonArray chunk;
+		const int count = engine.findStreamed(query, [conn, chunkSize, &chunk](const Common::Record &record) {
+			chunk.append(record.toJson());
+			if (chunk.size() >= chunkSize) {
+				conn->sendChunk(chunk);
+				chunk = QJsonArray();
+			}
+		});
+		if (!chunk.isEmpty()) {
+			conn->sendChunk(chunk);
+		}
+		return QJsonObject({
+							   {"count", count},
+							   {"revision", Json::toJson(revision)}
+						   });
+	});
+	m_commands.insert("aggregate", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) {
+		const Common::AggregateQuery query = Json::ensureIsType<Common::AggregateQuery>(data);
+		return engine.aggregate(query).toJson();
+	});
+	m_commands.insert("bootstrap", [](const QJsonValue &data, DatabaseEngine &engine, Connection *) {
+		const QJsonObject obj = Json::ensureObject(data);
+		const Common::Id competitionId = Json::ensureIsType<Common::Id>(obj, "competition_id");
+
+		// everything a client needs on startup in a single reply, which ends up compressed by the socket
+		QVector<Common::TableQuery> queries;
+		queries.append(Common::TableQuery(Common::Table::Competition, Common::TableFilter("id", competitionId)));
+		for (const QString &tableName : Json::ensureIsArrayOf<QString>(obj, "tables")) {
+			const Common::Table table = Common::fromTableName(tableName);
+			const QString path = competitionPath(table);
+			if (path.isNull()) {
+				throw Exception(QStringLiteral("Table %1 does not belong to a competition") % tableName);
+			}
+			queries.append(Common::TableQuery(table, Common::TableFilter(path, competitionId)));
+		}
+		return engine.snapshot(queries).toJson();
+	});
 	m_commands.insert("subscribe", [](const QJsonValue &data, DatabaseEngine &engine, Connection *conn) {
 		const Common::ChangeQuery query = Json::ensureIsType<Common::ChangeQuery>(data);
+		const QueryPlan plan(query.query()); // rejects invalid queries before anything is registered
 		const int id = conn->nextSubscriptionId;
-		conn->subscriptions.insert(id, query);
+		conn->subscriptions.insert(id, Subscription{query, plan});
 		conn->nextSubscriptionId += 1;
 		return QJsonObject({
 							   {"subscription", id},
 							   {"changes", engine.changes(query).toJson()}
 						   });
 	});
+	m_commands.insert("subscribe_aggregate", [](const QJsonValue &data, DatabaseEngine &engine, Connection *conn) {
+		const Common::AggregateQuery query = Json::ensureIsType<Common::AggregateQuery>(data);
+		const QJsonObject result = engine.aggregate(query).toJson();
+		const int id = conn->nextSubscriptionId;
+		conn->aggregateSubscriptions.insert(id, AggregateSubscription{query, result.value("groups").toArray()});
+		conn->nextSubscriptionId += 1;
+		return QJsonObject({
+							   {"subscription", id},
+							   {"result", result}
+						   });
+	});
 	m_commands.insert("unsubscribe", [](const QJsonValue &data, DatabaseEngine &, Connection *conn) {
 		if (data.isObject()) {
 			const Common::ChangeQuery query = Json::ensureIsType<Common::ChangeQuery>(data);
 			QVector<int> ids;
-			QMutableHashIterator<int, Common::ChangeQuery> it(conn->subscriptions);
+			QMutableHashIterator<int, Subscription> it(conn->subscriptions);
 			while (it.hasNext()) {
 				it.next();
-				if (it.value() == query) {
+				if (it.value().query == query) {
 					ids.append(it.key());
 					it.remove();
 				}
@@ -191,10 +364,11 @@ DatabaseServer::DatabaseServer(QSqlDatabase &db, const QString &password)
 			return Json::toJsonArray(ids);
 		} else {
 			const int id = Json::ensureInteger(data);
-			if (!conn->subscriptions.contains(id)) {
+			if (!conn->subscriptions.contains(id) && !conn->aggregateSubscriptions.contains(id)) {
 				throw Exception("Subscribtion ID does not exist");
 			}
 			conn->subscriptions.remove(id);
+			conn->aggregateSubscriptions.remove(id);
 			return Json::toJsonArray(QVector<int>() << id);
 		}
 	});
@@ -202,6 +376,25 @@ DatabaseServer::DatabaseServer(QSqlDatabase &db, const QString &password)
 
 DatabaseServer::~DatabaseServer()  {}
 
+void DatabaseServer::checkpoint(const qint64 retention)
+{
+	try {
+		const Common::Revision revision = m_engine.checkpoint(QDateTime::currentMSecsSinceEpoch() - retention);
+		qCInfo(server) << "change log checkpoint at revision" << revision;
+	} catch (Exception &e) {
+		qCCritical(server) << "unable to checkpoint change log:" << e.cause();
+	}
+}
+
+int DatabaseServer::setJournal(Journal *journal)
+{
+	const int count = journal->replay(m_engine);
+	m_engine.setJournal(journal);
+	// reads never have to go through SQL for a database that only lives in memory
+	m_engine.setAllResident();
+	return count;
+}
+
 void DatabaseServer::addConnection(Connection *conn, QObject *slotCtxt)
 {
 	qCDebug(server) << "new connection from" << conn->address();
@@ -221,6 +414,7 @@ void DatabaseServer::addConnection(Connection *conn, QObject *slotCtxt)
 			const QJsonObject msg = Json::ensureObject(Json::ensureDocument(data));
 			qCDebug(server) << "received" << msg;
 			msgId = Json::ensureInteger(msg, "msgId");
+			conn->currentMsgId = msgId;
 			const QString cmd = Json::ensureString(msg, "cmd");
 			QJsonValue value;
 
@@ -253,11 +447,19 @@ void DatabaseServer::addConnection(Connection *conn, QObject *slotCtxt)
 			qCDebug(server) << "sending" << reply;
 			conn->send(Json::toText(reply));
 		} catch (Exception &e) {
-			const QJsonObject msg = QJsonObject({
-													{"cmd", "error"},
-													{"data", e.cause()},
-													{"reply_to", msgId}
-												});
+			QJsonObject msg = QJsonObject({
+											  {"cmd", "error"},
+											  {"data", e.cause()},
+											  {"reply_to", msgId}
+										  });
+			// lets clients tell failed compare-and-sets apart from other errors, to reload and retry
+			if (dynamic_cast<ConflictException *>(&e)) {
+				msg.insert("conflict", true);
+			}
+			// and missing records apart from failures that say nothing about whether the record still exists
+			if (dynamic_cast<Database::DoesntExistException *>(&e)) {
+				msg.insert("not_found", true);
+			}
 			conn->send(Json::toText(msg));
 		}
 	});
@@ -267,24 +469,90 @@ void DatabaseServer::addConnection(Connection *conn, QObject *slotCtxt)
 void DatabaseServer::handleChange(const Common::Change &change)
 {
 	const Common::Record &record = change.record();
+
+	// the change is the same for all subscribers, so it is only serialized once
+	QJsonArray changes;
+	QJsonArray deltaChanges;
 	for (Connection *conn : m_connections) {
 		for (auto it = conn->subscriptions.constBegin(); it != conn->subscriptions.constEnd(); ++it) {
-			if (it.value().matches(change, record)) {
+			const Common::ChangeQuery &query = it.value().query;
+			if (change.revision() >= query.fromRevision() && it.value().plan.matches(record)) {
+				QJsonArray &serialized = query.isDelta() ? deltaChanges : changes;
+				if (serialized.isEmpty()) {
+					serialized.append(query.isDelta() ? change.toDelta().toJson() : change.toJson());
+				}
+
 				Common::ChangeResponse response;
-				response.setChanges(QVector<Common::Change>() << change);
-				response.setQuery(it.value());
+				response.setQuery(query);
 				response.setLastRevision(change.revision());
 
 				const QJsonObject msg = QJsonObject({
 														{"cmd", "changes"},
 														{"reply_to", it.key()},
-														{"data", response.toJson()}
+														{"data", response.toJson(serialized)}
 													});
 				qCDebug(server) << "sending" << msg;
 				conn->send(Json::toText(msg));
 			}
 		}
 	}
+
+	// the previous values of updated records are not known, so any change to the table may have moved records into or
+	// out of the aggregated set. changes made in quick succession are recomputed together after a short delay
+	const bool aggregated = std::any_of(m_connections.cbegin(), m_connections.cend(), [](const Connection *conn) {
+		return !conn->aggregateSubscriptions.isEmpty();
+	});
+	if (!aggregated) {
+		return;
+	}
+	m_aggregateTables.insert(record.table());
+	if (!m_aggregateTimer.isActive()) {
+		m_aggregateTimer.start();
+	}
+}
+
+void DatabaseServer::updateAggregates()
+{
+	const QSet<Common::Table> tables = m_aggregateTables;
+	m_aggregateTables.clear();
+
+	// results are computed once per distinct query
+	QVector<QPair<Common::AggregateQuery, QJsonObject>> results;
+	for (Connection *conn : m_connections) {
+		for (auto it = conn->aggregateSubscriptions.begin(); it != conn->aggregateSubscriptions.end(); ++it) {
+			// also recomputed for changes to the tables joined through the filters
+			if (!tables.intersects(queryTables(it.value().query.query()))) {
+				continue;
+			}
+
+			auto result = std::find_if(results.begin(), results.end(), [&it](const QPair<Common::AggregateQuery, QJsonObject> &pair) {
+				return pair.first == it.value().query;
+			});
+			if (result == results.end()) {
+				try {
+					results.append(qMakePair(it.value().query, m_engine.aggregate(it.value().query).toJson()));
+				} catch (Exception &e) {
+					qCCritical(server) << "unable to recompute aggregate:" << e.cause();
+					continue;
+				}
+				result = results.end() - 1;
+			}
+
+			const QJsonArray groups = result->second.value("groups").toArray();
+			if (groups == it.value().groups) {
+				continue;
+			}
+			it.value().groups = groups;
+
+			const QJsonObject msg = QJsonObject({
+													{"cmd", "aggregate"},
+													{"reply_to", it.key()},
+													{"data", result->second}
+												});
+			qCDebug(server) << "sending" << msg;
+			conn->send(Json::toText(msg));
+		}
+	}
 }
 
 TcpDatabaseServer::TcpDatabaseServer(QSqlDatabase &db, const QString &password)
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <QSqlDatabase>
+#include <QSet>
 #include <QTcpServer>
 #include <QLocalServer>
 #include <QLoggingCategory>
+#include <QTimer>
 
 #include "DatabaseEngine.h"
+#include "Journal.h"
 
 namespace Sportsed {
 namespace Server {
@@ -22,6 +25,14 @@ public:
 
 	virtual bool listen() = 0;
 
+	/// Trims changes older than the given retention (in ms) from the change log, clients that are further behind will
+	/// be told to resync
+	void checkpoint(const qint64 retention);
+
+	/// Replays the given journal and then keeps appending all changes to it, used when the database is not persistent.
+	/// All tables are kept resident from then on
+	int setJournal(Journal *journal);
+
 protected:
 	void addConnection(Connection *conn, QObject *slotCtxt);
 
@@ -34,7 +45,12 @@ private:
 
 	QHash<QString, std::function<QJsonValue(QJsonValue, DatabaseEngine&, Connection *)>> m_commands;
 
+	/// Tables changed since the aggregates have last been recomputed, which happens at most once per timeout
+	QSet<Common::Table> m_aggregateTables;
+	QTimer m_aggregateTimer;
+
 	void handleChange(const Common::Change &change);
+	void updateAggregates();
 };
 
 class TcpDatabaseServer : public QTcpServer, public DatabaseServer
@@ -0,0 +1,157 @@
+#include "Journal.h"
+
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include <jd-util/Formatting.h>
+#include <jd-util/Json.h>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "DatabaseEngine.h"
+
+using namespace JD::Util;
+
+namespace Sportsed {
+namespace Server {
+Q_LOGGING_CATEGORY(journal, "sportsed.server.journal")
+
+Journal::Journal(const QString &filename, QObject *parent)
+	: QObject(parent), m_file(filename)
+{
+	if (!m_file.open(QFile::ReadWrite)) {
+		throw JournalException("Unable to open journal %1: %2" % filename % m_file.errorString());
+	}
+
+	m_syncTimer.setSingleShot(true);
+	m_syncTimer.setInterval(20);
+	connect(&m_syncTimer, &QTimer::timeout, this, &Journal::sync);
+}
+Journal::~Journal()
+{
+	sync();
+}
+
+static QByteArray encodeEntry(const QJsonObject &entry)
+{
+	QByteArray line = QJsonDocument(entry).toJson(QJsonDocument::Compact);
+	line.append('\n');
+	return line;
+}
+
+int Journal::replay(DatabaseEngine &engine)
+{
+	m_file.seek(0);
+
+	// all entries are applied in a single transaction
+	qint64 validSize = 0;
+	bool terminated = true;
+	const int count = engine.replay([this, &validSize, &terminated](QJsonObject &entry) {
+		while (!m_file.atEnd()) {
+			const QByteArray line = m_file.readLine();
+			if (line.trimmed().isEmpty()) {
+				validSize = m_file.pos();
+				continue;
+			}
+
+			try {
+				entry = Json::ensureObject(Json::ensureDocument(line));
+			} catch (Exception &e) {
+				if (!m_file.atEnd()) {
+					throw JournalException("Corrupt journal entry at offset %1: %2" % validSize % e.cause());
+				}
+				qCWarning(journal) << "discarding incomplete journal entry at offset" << validSize;
+				return false;
+			}
+			validSize = m_file.pos();
+			terminated = line.endsWith('\n');
+			return true;
+		}
+		return false;
+	});
+
+	m_file.resize(validSize);
+	m_file.seek(validSize);
+	if (!terminated) {
+		// the last entry is complete, but the crash happened before its newline was written. without it the next entry
+		// would continue the same line
+		if (m_file.write("\n") != 1) {
+			throw JournalException("Unable to write to journal: %1" % m_file.errorString());
+		}
+		++m_pending;
+		sync();
+	}
+	qCInfo(journal) << "replayed" << count << "journal entries";
+	return count;
+}
+
+void Journal::append(const QJsonObject &entry)
+{
+	const QByteArray line = encodeEntry(entry);
+	if (m_file.write(line) != line.size()) {
+		throw JournalException("Unable to write to journal: %1" % m_file.errorString());
+	}
+
+	if (++m_pending >= m_maxPending) {
+		sync();
+	} else if (!m_syncTimer.isActive()) {
+		m_syncTimer.start();
+	}
+}
+
+void Journal::rewrite(const std::function<void(const Writer &)> &producer)
+{
+	sync();
+
+	QSaveFile file(m_file.fileName());
+	if (!file.open(QFile::WriteOnly)) {
+		throw JournalException("Unable to rewrite journal %1: %2" % file.fileName() % file.errorString());
+	}
+	int count = 0;
+	producer([&file, &count](const QJsonObject &entry) {
+		const QByteArray line = encodeEntry(entry);
+		if (file.write(line) != line.size()) {
+			throw JournalException("Unable to write to journal: %1" % file.errorString());
+		}
+		++count;
+	});
+	if (!file.commit()) {
+		throw JournalException("Unable to replace journal %1: %2" % file.fileName() % file.errorString());
+	}
+
+	// the old file has been replaced, entries have to go to the new one from now on
+	m_file.close();
+	if (!m_file.open(QFile::ReadWrite)) {
+		throw JournalException("Unable to open journal %1: %2" % m_file.fileName() % m_file.errorString());
+	}
+	m_file.seek(m_file.size());
+	qCInfo(journal) << "rewrote journal to" << count << "entries";
+}
+
+void Journal::sync()
+{
+	m_syncTimer.stop();
+	if (m_pending == 0) {
+		return;
+	}
+	m_pending = 0;
+
+	if (!m_file.flush()) {
+		qCCritical(journal) << "unable to flush journal:" << m_file.errorString();
+		return;
+	}
+#ifdef Q_OS_WIN
+	if (_commit(m_file.handle()) != 0) {
+#else
+	if (::fsync(m_file.handle()) != 0) {
+#endif
+		qCCritical(journal) << "unable to sync journal to disk";
+	}
+}
+
+}
+}
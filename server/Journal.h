@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <functional>
+
+#include <jd-util/Exception.h>
+
+namespace Sportsed {
+namespace Server {
+
+class DatabaseEngine;
+
+DECLARE_EXCEPTION(Journal)
+Q_DECLARE_LOGGING_CATEGORY(journal)
+
+/// Append-only log of all changes, which keeps an in-memory database durable across restarts
+///
+/// Every line is a change log entry as produced by DatabaseEngine. Writes are buffered and flushed to disk in batches,
+/// either once the sync interval has passed or once enough entries are pending. Checkpoints rewrite the journal to a
+/// snapshot of all records followed by the remaining change log, see DatabaseEngine::checkpoint().
+class Journal : public QObject
+{
+	Q_OBJECT
+public:
+	explicit Journal(const QString &filename, QObject *parent = nullptr);
+	~Journal() override;
+
+	/// Applies all entries of the journal to the given engine, returns the number of entries applied
+	///
+	/// A partially written last entry (from a crash while writing) is discarded.
+	int replay(DatabaseEngine &engine);
+
+	void append(const QJsonObject &entry);
+	/// Writes all pending entries and waits for them to reach the disk
+	void sync();
+
+	using Writer = std::function<void(const QJsonObject &entry)>;
+	/// Replaces all entries by the ones handed to the writer. The new journal only takes the place of the old one once
+	/// it is complete and on disk, so a crash in between leaves the old journal behind
+	void rewrite(const std::function<void(const Writer &write)> &producer);
+
+	void setSyncInterval(const int msecs) { m_syncTimer.setInterval(msecs); }
+	void setMaxPending(const int maxPending) { m_maxPending = maxPending; }
+
+private:
+	QFile m_file;
+	QTimer m_syncTimer;
+	int m_pending = 0;
+	int m_maxPending = 256;
+};
+
+}
+}
@@ -0,0 +1,300 @@
+#include "QueryPlan.h"
+
+#include <QStringList>
+#include <QSqlDriver>
+
+#include <jd-util/Formatting.h>
+
+#include "commonlib/Schema.h"
+
+using namespace JD::Util;
+
+namespace Sportsed {
+namespace Server {
+
+Common::Table referencedTable(const Common::Table table, const QString &field)
+{
+	const Common::TableSchema &schema = Common::tableSchema(table);
+	const int index = schema.indexOf(field);
+	if (index == -1 || schema.field(index).type != Common::BaseValidator::ID || !field.endsWith("_id")) {
+		throw ValidationException(QStringLiteral("'%1' is not a foreign key of %2") % field % Common::tableName(table));
+	}
+	try {
+		return Common::fromTableName(QString(field).remove("_id"));
+	} catch (Common::InvalidTableNameException &) {
+		throw ValidationException(QStringLiteral("'%1' is not a foreign key of %2") % field % Common::tableName(table));
+	}
+}
+
+static void collectFilterTables(const Common::TableFilter &filter, QSet<Common::Table> &tables)
+{
+	for (const Common::TableFilter &child : filter.children()) {
+		collectFilterTables(child, tables);
+	}
+	// all but the last part of a multi-level field name a joined table, see conditionForFilter()
+	const QStringList fields = filter.field().split('>');
+	for (int i = 0; i < fields.size() - 1; ++i) {
+		tables.insert(Common::fromTableName(QString(fields.at(i)).remove("_id")));
+	}
+}
+QSet<Common::Table> queryTables(const Common::TableQuery &query)
+{
+	QSet<Common::Table> tables{query.table()};
+	for (const Common::TableFilter &filter : query.filters()) {
+		collectFilterTables(filter, tables);
+	}
+	for (const QString &include : query.includes()) {
+		Common::Table table = query.table();
+		for (const QString &field : include.split('>')) {
+			table = referencedTable(table, field);
+			tables.insert(table);
+		}
+	}
+	return tables;
+}
+
+static void validateQuery(const Common::TableQuery &query)
+{
+	const Common::TableSchema &schema = Common::tableSchema(query.table());
+	for (const QString &field : query.fields()) {
+		if (field != "id" && schema.indexOf(field) == -1) {
+			throw ValidationException(QStringLiteral("Unknown field '%1' in projection") % field);
+		}
+	}
+	for (const Common::TableSort &sort : query.sort()) {
+		if (sort.field() != "id" && schema.indexOf(sort.field()) == -1) {
+			throw ValidationException(QStringLiteral("Unknown sort field '%1'") % sort.field());
+		}
+	}
+	if (query.limit() < 0) {
+		throw ValidationException("Negative limit");
+	}
+	if (!query.after().isEmpty() && query.after().size() != query.sort().size() + 1) {
+		throw ValidationException("Cursor needs a value for every sort key followed by an id");
+	}
+	for (const QString &include : query.includes()) {
+		const QStringList fields = include.split('>');
+		if (query.isProjected() && !query.fields().contains(fields.first())) {
+			throw ValidationException(QStringLiteral("Included field '%1' is not part of the projection") % fields.first());
+		}
+		Common::Table table = query.table();
+		for (const QString &field : fields) {
+			table = referencedTable(table, field);
+		}
+	}
+}
+
+/// Smallest string that is greater than all strings starting with the prefix, null if there is none
+static QString prefixSuccessor(QString prefix)
+{
+	while (!prefix.isEmpty() && prefix.at(prefix.size() - 1).unicode() == 0xffff) {
+		prefix.chop(1);
+	}
+	if (prefix.isEmpty()) {
+		return QString();
+	}
+	prefix[prefix.size() - 1] = QChar(prefix.at(prefix.size() - 1).unicode() + 1);
+	return prefix;
+}
+
+static QString escapedTable(const QSqlDriver *driver, const QString &table)
+{
+	return driver->escapeIdentifier(table, QSqlDriver::TableName);
+}
+static QString escapedColumn(const QSqlDriver *driver, const QString &table, const QString &field)
+{
+	return escapedTable(driver, table) + '.' + driver->escapeIdentifier(field, QSqlDriver::FieldName);
+}
+
+/// The column compared by character codes like QString does, instead of by the collation of the database
+static QString binaryColumn(const QSqlDriver *driver, const QString &column)
+{
+	if (driver->dbmsType() == QSqlDriver::PostgreSQL) {
+		return column + " COLLATE \"C\"";
+	} else if (driver->dbmsType() == QSqlDriver::MySqlServer) {
+		return "BINARY " + column;
+	} else {
+		return column + " COLLATE BINARY";
+	}
+}
+
+static QString conditionForFilter(const QSqlDriver *driver, const Common::TableQuery &query, const Common::TableFilter &filter,
+								  QStringList &joins, QVector<QVariant> &values)
+{
+	if (filter.isGroup()) {
+		QStringList conditions;
+		for (const Common::TableFilter &child : filter.children()) {
+			conditions.append(conditionForFilter(driver, query, child, joins, values));
+		}
+		switch (filter.op()) {
+		case Common::TableFilter::And: return conditions.isEmpty() ? "1 = 1" : '(' + conditions.join(" AND ") + ')';
+		case Common::TableFilter::Or: return conditions.isEmpty() ? "1 = 0" : '(' + conditions.join(" OR ") + ')';
+		case Common::TableFilter::Not:
+			if (conditions.size() != 1) {
+				throw ValidationException("Negations need exactly one filter");
+			}
+			return "NOT " + conditions.first();
+		default: Q_UNREACHABLE();
+		}
+	}
+
+	QString column;
+	if (filter.field().contains('>')) {
+		// special filtering in the format table_a_id>table_b_id>table_c_id that will use joins to match the table_a_id field
+		// in the current table against the id field in table_a, table_b_id in table_a against table_b.id etc. and table_c_id
+		// against the given value. left joins keep rows without a referenced record around for other branches of an OR
+
+		const QStringList fields = filter.field().split('>');
+		for (int i = 0; i < fields.size(); ++i) {
+			if (i != (fields.size()-1)) {
+				const QString field = fields.at(i);
+				const QString table = QString(field).remove("_id");
+				const QString prevTable = i == 0 ? Common::tableName(query.table()) : QString(fields.at(i-1)).remove("_id");
+				const QString join = QStringLiteral(" LEFT JOIN %1 ON %2 = %3")
+						.arg(escapedTable(driver, table), escapedColumn(driver, table, "id"), escapedColumn(driver, prevTable, field));
+				if (!joins.contains(join)) {
+					joins.append(join);
+				}
+			}
+		}
+		column = escapedColumn(driver, QString(fields.at(fields.size()-2)).remove("_id"), fields.last());
+	} else {
+		// normal filtering
+		column = escapedColumn(driver, Common::tableName(query.table()), filter.field());
+	}
+
+	switch (filter.op()) {
+	case Common::TableFilter::Equal: values.append(filter.value()); return column + " = ?";
+	case Common::TableFilter::NotEqual: values.append(filter.value()); return column + " <> ?";
+	case Common::TableFilter::Less: values.append(filter.value()); return column + " < ?";
+	case Common::TableFilter::LessEqual: values.append(filter.value()); return column + " <= ?";
+	case Common::TableFilter::Greater: values.append(filter.value()); return column + " > ?";
+	case Common::TableFilter::GreaterEqual: values.append(filter.value()); return column + " >= ?";
+	case Common::TableFilter::In: {
+		const QVariantList list = filter.value().toList();
+		if (list.isEmpty()) {
+			return "1 = 0";
+		}
+		QStringList placeholders;
+		for (const QVariant &value : list) {
+			placeholders.append("?");
+			values.append(value);
+		}
+		return QStringLiteral("%1 IN (%2)").arg(column, placeholders.join(", "));
+	}
+	case Common::TableFilter::Between: {
+		const QVariantList bounds = filter.value().toList();
+		if (bounds.size() != 2) {
+			throw ValidationException(QStringLiteral("Expected lower and upper bound for field '%1'") % filter.field());
+		}
+		values.append(bounds.at(0));
+		values.append(bounds.at(1));
+		return column + " BETWEEN ? AND ?";
+	}
+	case Common::TableFilter::StartsWith: {
+		// a range instead of LIKE, which is case insensitive in SQLite and would not be able to use indexes. it has to
+		// be compared binary to match the same strings as QString::startsWith()
+		const QString prefix = filter.value().toString();
+		const QString successor = prefixSuccessor(prefix);
+		const QString binary = binaryColumn(driver, column);
+		values.append(prefix);
+		if (successor.isNull()) {
+			return binary + " >= ?";
+		}
+		values.append(successor);
+		return QStringLiteral("(%1 >= ? AND %1 < ?)").arg(binary);
+	}
+	case Common::TableFilter::IsNull:
+		return column + (filter.value().toBool() ? " IS NULL" : " IS NOT NULL");
+	case Common::TableFilter::And:
+	case Common::TableFilter::Or:
+	case Common::TableFilter::Not:
+		Q_UNREACHABLE(); // handled above
+	}
+}
+
+static QPair<QString, QVector<QVariant>> whereForQuery(const QSqlDriver *driver, const Common::TableQuery &query)
+{
+	QStringList joins;
+	QStringList items;
+	items.append("1 = 1"); // eliminates the need for special casing an empty query in the caller
+	QVector<QVariant> values;
+	for (const Common::TableFilter &filter : query.filters()) {
+		items.append(conditionForFilter(driver, query, filter, joins, values));
+	}
+
+	if (!query.after().isEmpty()) {
+		// keyset pagination: (a > ?) OR (a = ? AND b > ?) OR (a = ? AND b = ? AND id > ?) for sort keys a and b. NULL
+		// comes first in ascending and last in descending order (see orderForQuery()) and needs comparisons of its own
+		QVector<Common::TableSort> keys = query.sort();
+		keys.append(Common::TableSort("id"));
+		QStringList alternatives;
+		for (int i = 0; i < keys.size(); ++i) {
+			QStringList conditions;
+			QVector<QVariant> conditionValues;
+			for (int j = 0; j <= i; ++j) {
+				const QString column = escapedColumn(driver, Common::tableName(query.table()), keys.at(j).field());
+				const QVariant &cursor = query.after().at(j);
+				if (j < i && cursor.isNull()) {
+					conditions.append(column + " IS NULL");
+				} else if (j < i) {
+					conditions.append(column + " = ?");
+					conditionValues.append(cursor);
+				} else if (cursor.isNull() && keys.at(j).isDescending()) {
+					conditions.clear(); // nothing comes after NULL
+					break;
+				} else if (cursor.isNull()) {
+					conditions.append(column + " IS NOT NULL");
+				} else if (keys.at(j).isDescending()) {
+					conditions.append(QStringLiteral("(%1 < ? OR %1 IS NULL)").arg(column));
+					conditionValues.append(cursor);
+				} else {
+					conditions.append(column + " > ?");
+					conditionValues.append(cursor);
+				}
+			}
+			if (!conditions.isEmpty()) {
+				alternatives.append('(' + conditions.join(" AND ") + ')');
+				values += conditionValues;
+			}
+		}
+		items.append(alternatives.isEmpty() ? "1 = 0" : '(' + alternatives.join(" OR ") + ')');
+	}
+
+	return qMakePair(joins.join(" ") + " WHERE " + items.join(" AND "), values);
+}
+static QString orderForQuery(const QSqlDriver *driver, const Common::TableQuery &query)
+{
+	// SQLite and MySQL sort NULL before all other values like Common::TableSort::compare() does, PostgreSQL after them
+	const bool nullsLargest = driver->dbmsType() == QSqlDriver::PostgreSQL;
+	QStringList keys;
+	for (const Common::TableSort &sort : query.sort()) {
+		QString key = escapedColumn(driver, Common::tableName(query.table()), sort.field())
+				+ (sort.isDescending() ? QStringLiteral(" DESC") : QStringLiteral(" ASC"));
+		if (nullsLargest) {
+			key += sort.isDescending() ? QStringLiteral(" NULLS LAST") : QStringLiteral(" NULLS FIRST");
+		}
+		keys.append(key);
+	}
+	keys.append(escapedColumn(driver, Common::tableName(query.table()), "id") + " ASC");
+	QString order = " ORDER BY " + keys.join(", ");
+	if (query.limit() > 0) {
+		order += QStringLiteral(" LIMIT %1").arg(query.limit());
+	}
+	return order;
+}
+
+QueryPlan::QueryPlan(const Common::TableQuery &query, const QSqlDriver *driver)
+	: m_query(query), m_predicate(query)
+{
+	validateQuery(query);
+	if (driver) {
+		const QPair<QString, QVector<QVariant>> where = whereForQuery(driver, query);
+		m_where = where.first;
+		m_values = where.second;
+		m_order = orderForQuery(driver, query);
+	}
+}
+
+}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <QVariant>
+
+#include <jd-util/Exception.h>
+
+#include "commonlib/TableQuery.h"
+#include "commonlib/QueryPredicate.h"
+
+class QSqlDriver;
+
+namespace Sportsed {
+namespace Server {
+
+DECLARE_EXCEPTION(Validation)
+
+/// Table referenced by the given foreign key field of the table, throws a ValidationException for other fields
+Common::Table referencedTable(const Common::Table table, const QString &field);
+/// The table of the query and all tables joined for its filters or includes, changes to any of them may affect the result
+QSet<Common::Table> queryTables(const Common::TableQuery &query);
+
+/// A TableQuery compiled once into everything needed to run it against the database and to match changes against it
+class QueryPlan
+{
+public:
+	/// Throws a ValidationException if the query references unknown fields or is malformed. The SQL is written for the
+	/// given driver, without one the plan can only be used for matching
+	explicit QueryPlan(const Common::TableQuery &query = Common::TableQuery(Common::Table::Null),
+					   const QSqlDriver *driver = nullptr);
+
+	const Common::TableQuery &query() const { return m_query; }
+	Common::Table table() const { return m_query.table(); }
+
+	/// Joins and WHERE clause to follow "FROM <table>", with placeholders for values()
+	const QString &where() const { return m_where; }
+	const QVector<QVariant> &values() const { return m_values; }
+	/// ORDER BY and LIMIT clause
+	const QString &order() const { return m_order; }
+
+	/// Whether the record may be part of the result of the query, see Common::QueryPredicate
+	bool matches(const Common::Record &record) const { return m_predicate.matches(record); }
+
+private:
+	Common::TableQuery m_query;
+	QString m_where;
+	QVector<QVariant> m_values;
+	QString m_order;
+	Common::QueryPredicate m_predicate;
+};
+
+}
+}
@@ -0,0 +1,9 @@
+#include "RecordStore.h"
+
+namespace Sportsed {
+namespace Server {
+
+RecordStore::~RecordStore() {}
+
+}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <QVector>
+
+#include "commonlib/Record.h"
+#include "commonlib/TableQuery.h"
+
+namespace Sportsed {
+namespace Server {
+
+/// In-memory storage of the non-deleted records of a table, which DatabaseEngine serves reads and finds from without
+/// going through SQL where possible
+///
+/// The database stays the source of truth for writes and the change log: stores are filled from it, kept up to date
+/// with every committed change and rebuilt after checkpoints.
+class RecordStore
+{
+public:
+	virtual ~RecordStore();
+
+	virtual Common::Table table() const = 0;
+	virtual int size() const = 0;
+
+	virtual void clear() = 0;
+	/// Inserts or replaces a complete record, throws a CoercionException if a value can not be stored
+	virtual void upsert(const Common::Record &record) = 0;
+	virtual void remove(const Common::Id id) = 0;
+
+	/// The complete record with the given id, or a null record if the store does not contain it
+	virtual Common::Record read(const Common::Id id) const = 0;
+	/// Returns all records matching the query, ordered by id, or nothing if the store is unable to evaluate the query
+	virtual std::optional<QVector<Common::Record>> find(const Common::TableQuery &query) const = 0;
+};
+
+}
+}
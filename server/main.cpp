@@ -3,10 +3,12 @@
 #include <QSqlDatabase>
 #include <QSqlError>
 #include <QDir>
+#include <QTimer>
 
 #include <jd-util/TermUtil.h>
 #include <jd-util/Logging.h>
 #include <iostream>
+#include <memory>
 
 #include "DatabaseServer.h"
 #include "DatabaseMigration.h"
@@ -30,12 +32,14 @@ int main(int argc, char **argv)
 	parser.addVersionOption();
 	parser.addOption(QCommandLineOption({"p", "port"}, "Which port to listen on", "PORT", "7384"));
 	parser.addOption(QCommandLineOption("password", "Password to access the server", "PASSWORD", "password"));
-	parser.addOption(QCommandLineOption("db-type", "Type of database used (one of: psql, mysql, sqlite)", "TYPE", "psql"));
+	parser.addOption(QCommandLineOption("db-type", "Type of database used (one of: psql, mysql, sqlite, memory)", "TYPE", "psql"));
 	parser.addOption(QCommandLineOption("db-host", "Adress of the database to connect to", "IP", "localhost"));
 	parser.addOption(QCommandLineOption("db-port", "Port of the database to connect to", "PORT", "5432"));
 	parser.addOption(QCommandLineOption("db-user", "Username for authenticating with the database", "USERNAME", "root"));
 	parser.addOption(QCommandLineOption("db-pass", "Password for authenticating with the database", "PASSWORD", ""));
 	parser.addOption(QCommandLineOption("db-name", "Name of the database to use", "NAME", "sportsed"));
+	parser.addOption(QCommandLineOption("journal", "Where to keep the changes of an in-memory database", "PATH", "sportsed.journal"));
+	parser.addOption(QCommandLineOption("retention", "How many hours of changes to keep, 0 to keep all", "HOURS", "48"));
 	parser.addOption(QCommandLineOption("debug", "Use a debugging friendly db setup"));
 
 	parser.process(app);
@@ -46,16 +50,22 @@ int main(int argc, char **argv)
 		driverName = "QPSQL";
 	} else if (dbType == "mysql") {
 		driverName = "QMYSQL";
-	} else if (dbType == "sqlite") {
+	} else if (dbType == "sqlite" || dbType == "memory") {
 		driverName = "QSQLITE";
 	} else {
-		qCritical() << Term::fg(Term::Red, "Invalid database type '%1', should be one of 'psql', 'mysql' or 'sqlite'\n" % dbType);
+		qCritical() << Term::fg(Term::Red, "Invalid database type '%1', should be one of 'psql', 'mysql', 'sqlite' or 'memory'\n" % dbType);
 		return -1;
 	}
 
 	QSqlDatabase db = QSqlDatabase::addDatabase(driverName);
+	if (driverName == "QMYSQL") {
+		// updates that do not change any value still count as affected, compare-and-set relies on that
+		db.setConnectOptions("CLIENT_FOUND_ROWS=1");
+	}
 	if (parser.isSet("debug")) {
 		db.setDatabaseName(QDir::current().absoluteFilePath("sportsed_debug.sqlite"));
+	} else if (dbType == "memory") {
+		db.setDatabaseName(":memory:");
 	} else {
 		db.setHostName(parser.value("db-host"));
 		db.setPort(parser.value("db-port").toInt());
@@ -75,12 +85,32 @@ int main(int argc, char **argv)
 		return -1;
 	}
 
+	// declared before the server so that it outlives the engine that appends to it
+	std::unique_ptr<Journal> journal;
 	TcpDatabaseServer server(db, parser.value("password"));
+	if (dbType == "memory") {
+		try {
+			journal = std::make_unique<Journal>(QDir::current().absoluteFilePath(parser.value("journal")));
+			server.setJournal(journal.get());
+		} catch (Exception &e) {
+			qCritical() << Term::fg(Term::Red, e.cause() + '\n');
+			return -1;
+		}
+	}
+
 	if (!server.listen()) {
 		qCritical() << Term::fg(Term::Red, server.errorString());
 		return -1;
 	}
 	qInfo() << Term::fg(Term::Green, QStringLiteral("Server is now listening on 0.0.0.0:%1") % server.serverPort());
 
+	const qint64 retention = parser.value("retention").toLongLong() * 60 * 60 * 1000;
+	if (retention > 0) {
+		QTimer *checkpointTimer = new QTimer(&app);
+		QObject::connect(checkpointTimer, &QTimer::timeout, &app, [&server, retention]() { server.checkpoint(retention); });
+		checkpointTimer->start(60 * 60 * 1000);
+		server.checkpoint(retention);
+	}
+
 	return app.exec();
 }
@@ -1,10 +1,15 @@
 #include <tst_Util.h>
 #include <QDebug>
 #include <QDate>
+#include <QDateTime>
+#include <QTemporaryDir>
+#include <QFileInfo>
+#include <QJsonObject>
 #include <jd-util-sql/DatabaseUtil.h>
 
 #include "DatabaseEngine.h"
 #include "DatabaseMigration.h"
+#include "Journal.h"
 
 using namespace Sportsed::Server;
 using namespace Sportsed::Common;
@@ -122,6 +127,84 @@ TEST_CASE("crud operations & change recording") {
 		REQUIRE(changes.changes()[1].record().table() == Table::Profile);
 		REQUIRE(changes.changes()[1].updatedFields().isEmpty());
 	}
+	SECTION("post-images") {
+		QSqlDatabase db = database();
+		DatabaseEngine e(db);
+		Record in = createRecord();
+		REQUIRE_NOTHROW(e.create(in));
+
+		Record update(in.table());
+		update.setId(1);
+		update.setValue("name", "bar");
+		REQUIRE_NOTHROW(e.update(update));
+		update.setValue("name", "baz");
+		REQUIRE_NOTHROW(e.update(update));
+
+		// every change carries the record as of its own revision, not the current state
+		auto changes = e.changes(ChangeQuery({TableQuery(Table::Profile)}));
+		REQUIRE(changes.changes().size() == 3);
+		REQUIRE(changes.changes()[0].record().value("name") == "foo");
+		REQUIRE(changes.changes()[1].record().value("name") == "bar");
+		REQUIRE(changes.changes()[2].record().value("name") == "baz");
+		REQUIRE(changes.changes()[0].record().value("type") == "asdf");
+		REQUIRE(changes.changes()[1].record().latestRevision() == changes.changes()[1].revision());
+		REQUIRE(changes.changes()[2].record().isComplete());
+	}
+	SECTION("delta changes") {
+		QSqlDatabase db = database();
+		DatabaseEngine e(db);
+		Record in = createRecord();
+		REQUIRE_NOTHROW(e.create(in));
+
+		Record update(in.table());
+		update.setId(1);
+		update.setValue("name", "bar");
+		REQUIRE_NOTHROW(e.update(update));
+
+		ChangeQuery query(TableQuery(Table::Profile));
+		query.setDelta(true);
+		auto changes = e.changes(query);
+		REQUIRE(changes.changes().size() == 2);
+		REQUIRE_FALSE(changes.changes()[0].isDelta());
+		REQUIRE(changes.changes()[0].record().value("name") == "foo");
+		REQUIRE(changes.changes()[1].isDelta());
+		REQUIRE(changes.changes()[1].record().id() == 1);
+		REQUIRE(changes.changes()[1].record().latestRevision() == changes.changes()[1].revision());
+		REQUIRE(changes.changes()[1].record().values() == update.values());
+	}
+	SECTION("compacted changes") {
+		QSqlDatabase db = database();
+		DatabaseEngine e(db);
+		Record in = createRecord();
+		REQUIRE_NOTHROW(e.create(in));
+		REQUIRE_NOTHROW(e.create(in));
+
+		Record update(in.table());
+		update.setId(1);
+		for (const QString &name : {"a", "b", "c"}) {
+			update.setValue("name", name);
+			REQUIRE_NOTHROW(e.update(update));
+		}
+		REQUIRE_NOTHROW(e.delete_(Table::Profile, 2));
+
+		ChangeQuery query(TableQuery(Table::Profile));
+		query.setCompact(true);
+		auto changes = e.changes(query);
+		REQUIRE(changes.changes().size() == 1);
+		REQUIRE(changes.changes()[0].type() == Change::Create);
+		REQUIRE(changes.changes()[0].record().id() == 1);
+		REQUIRE(changes.changes()[0].record().value("name") == "c");
+		REQUIRE(changes.changes()[0].revision() == 5);
+
+		// from an existing record the updates merge into a single update
+		query.setFromRevision(2);
+		changes = e.changes(query);
+		REQUIRE(changes.changes().size() == 2);
+		REQUIRE(changes.changes()[0].type() == Change::Update);
+		REQUIRE(changes.changes()[0].updatedFields() == QVector<QString>({"name"}));
+		REQUIRE(changes.changes()[1].type() == Change::Delete);
+		REQUIRE(changes.changes()[1].record().id() == 2);
+	}
 	SECTION("change callback") {
 		QSqlDatabase db = database();
 		DatabaseEngine e(db);
@@ -143,6 +226,15 @@ TEST_CASE("crud operations & change recording") {
 	}
 }
 
+static QVector<Id> ids(const QVector<Record> &records)
+{
+	QVector<Id> out;
+	for (const Record &record : records) {
+		out.append(record.id());
+	}
+	return out;
+}
+
 TEST_CASE("searching") {
 	QSqlDatabase db = database();
 	DatabaseEngine e(db);
@@ -199,6 +291,878 @@ TEST_CASE("searching") {
 	REQUIRE(coursesX == (QVector<Record>() << courseA << courseB << courseC));
 	REQUIRE(coursesY == (QVector<Record>() << courseD));
 
+	SECTION("projection") {
+		TableQuery query(Table::Profile, TableFilter("name", "b"));
+		query.setFields({"name"});
+		const QVector<Record> projected = e.find(query);
+		REQUIRE(projected.size() == 1);
+		REQUIRE(projected.at(0).id() == resultAll.at(1).id());
+		REQUIRE(projected.at(0).value("name") == "b");
+		REQUIRE_FALSE(projected.at(0).hasValue("value"));
+		REQUIRE_FALSE(projected.at(0).isComplete());
+
+		const Record read = e.read(Table::Profile, projected.at(0).id(), false, {"type"});
+		REQUIRE(read.fields() == QVector<QString>({"type"}));
+
+		// resident table
+		TableQuery stages(Table::Stage, TableFilter("competition_id", compA.id()));
+		stages.setFields({"name", "discipline"});
+		const QVector<Record> projectedStages = e.find(stages);
+		REQUIRE(projectedStages.size() == 2);
+		REQUIRE(projectedStages.at(0).fields() == QVector<QString>({"name", "discipline"}));
+		REQUIRE(projectedStages.at(0).id() == stage1.id());
+
+		// the projected records must not replace the complete ones in the cache
+		e.setResident(Table::Stage, false);
+		REQUIRE(e.find(stages).size() == 2);
+		const Record cached = e.read(Table::Stage, stage1.id());
+		REQUIRE(cached.isComplete());
+		REQUIRE(cached == stage1);
+		e.setResident(Table::Stage, true);
+
+		query.setFields({"nonexistent"});
+		REQUIRE_THROWS_AS(e.find(query), ValidationException);
+	}
+
+	SECTION("streamed") {
+		QVector<Record> streamed;
+		const auto collect = [&streamed](const Record &record) { streamed.append(record); };
+		REQUIRE(e.findStreamed(TableQuery(Table::Course, TableFilter("stage_id>competition_id", compA.id())), collect) == 3);
+		REQUIRE(streamed == coursesX);
+
+		// resident table
+		streamed.clear();
+		REQUIRE(e.findStreamed(TableQuery(Table::Stage, TableFilter("competition_id", compA.id())), collect) == 2);
+		REQUIRE(ids(streamed) == (QVector<Id>() << stage1.id() << stage2.id()));
+
+		streamed.clear();
+		REQUIRE(e.findStreamed(TableQuery(Table::Profile, TableFilter("name", "nonexistent")), collect) == 0);
+		REQUIRE(streamed.isEmpty());
+	}
+
+	SECTION("read many") {
+		const QVector<Record> records = e.readMany(Table::Course, {courseC.id(), 9999, courseA.id(), courseC.id()});
+		REQUIRE(records.size() == 4);
+		REQUIRE(records.at(0) == courseC);
+		REQUIRE(records.at(1).isNull());
+		REQUIRE(records.at(2) == courseA);
+		REQUIRE(records.at(3) == courseC);
+
+		const RecordBatch batch = RecordBatch::fromJson(RecordBatch(records).toJson());
+		REQUIRE(batch.records().size() == 4);
+		REQUIRE(batch.records().at(1).isNull());
+		REQUIRE(batch.records().at(2).id() == courseA.id());
+
+		// more ids than are looked up in a single query
+		QVector<Id> many;
+		for (Id id = 10000; id < 11200; ++id) {
+			many.append(id);
+		}
+		many.append(resultAll.at(1).id());
+		const QVector<Record> manyRecords = e.readMany(Table::Profile, many);
+		REQUIRE(manyRecords.size() == many.size());
+		REQUIRE(manyRecords.first().isNull());
+		REQUIRE(manyRecords.last().id() == resultAll.at(1).id());
+
+		// cached table
+		REQUIRE(ids(e.readMany(Table::Stage, {stage2.id(), stage1.id()})) == (QVector<Id>() << stage2.id() << stage1.id()));
+		REQUIRE_NOTHROW(e.delete_(Table::Stage, stage2.id()));
+		REQUIRE(e.readMany(Table::Stage, {stage2.id()}).first().isNull());
+		REQUIRE(e.readMany(Table::Stage, {}).isEmpty());
+	}
+
+	SECTION("snapshot") {
+		const TableQuery stages(Table::Stage, TableFilter("competition_id", compA.id()));
+		const TableQuery courses(Table::Course, TableFilter("stage_id>competition_id", compA.id()));
+		Snapshot snapshot = Snapshot::fromJson(e.snapshot({stages, courses}).toJson());
+		REQUIRE(snapshot.revision() == e.latestRevision());
+		REQUIRE(snapshot.records(courses));
+		REQUIRE(ids(*snapshot.records(courses)) == ids(coursesX));
+		REQUIRE(ids(*snapshot.records(stages)) == (QVector<Id>() << stage1.id() << stage2.id()));
+		REQUIRE(ids(snapshot.records(Table::Course)) == ids(coursesX));
+		REQUIRE_FALSE(snapshot.records(TableQuery(Table::Course)));
+
+		// results that have been taken are gone
+		REQUIRE(ids(*snapshot.take(courses)) == ids(coursesX));
+		REQUIRE_FALSE(snapshot.take(courses));
+		REQUIRE(ids(snapshot.take(Table::Stage)) == (QVector<Id>() << stage1.id() << stage2.id()));
+		REQUIRE(snapshot.isEmpty());
+
+		// nothing is read if any of the queries is invalid
+		TableQuery invalid(Table::Stage);
+		invalid.setSort({TableSort("nonexistent")});
+		REQUIRE_THROWS_AS(e.snapshot({stages, invalid}), ValidationException);
+	}
+
+	SECTION("includes") {
+		TableQuery query(Table::Course, TableFilter("stage_id>competition_id", compA.id()));
+		query.setIncludes({"stage_id", "stage_id>competition_id"});
+		const FindResult result = e.findIncluding(TableQuery::fromJson(query.toJson()));
+		REQUIRE(result.records() == coursesX);
+		// stage 1 is referenced twice and by both paths, but only included once
+		REQUIRE(ids(result.included()) == (QVector<Id>() << stage1.id() << stage2.id() << compA.id()));
+		REQUIRE(result.included(Table::Competition, compA.id()).value("name") == "comp a");
+		REQUIRE(result.included(Table::Competition, compB.id()).table() == Table::Null);
+
+		const FindResult roundTrip = FindResult::fromJson(result.toJson());
+		REQUIRE(ids(roundTrip.included()) == ids(result.included()));
+
+		query.setIncludes({"name"});
+		REQUIRE_THROWS_AS(e.findIncluding(query), ValidationException);
+		query.setIncludes({"stage_id>nonexistent_id"});
+		REQUIRE_THROWS_AS(e.findIncluding(query), ValidationException);
+		query.setIncludes({"stage_id"});
+		query.setFields({"name"});
+		REQUIRE_THROWS_AS(e.findIncluding(query), ValidationException);
+	}
+}
+
+TEST_CASE("filter operators") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	QVector<Record> profiles;
+	for (int i = 0; i < 10; ++i) {
+		Record record = createRecord();
+		record.setValue("name", QStringLiteral("%1 profile %2").arg(i < 5 ? "ab" : "ac").arg(i));
+		profiles.append(e.create(record));
+	}
+	const auto comp = e.create(Record(Table::Competition, {{"name", "comp"}, {"sport", "Orienteering"}}));
+	const auto stage = e.create(Record(Table::Stage, {
+										   {"name", "stage"},
+										   {"date", QDate::currentDate()},
+										   {"discipline", "Middle"},
+										   {"in_totals", true},
+										   {"type", "Relay"},
+										   {"competition_id", comp.id()}
+									   }));
+	const auto courseA = e.create(Record(Table::Course, {{"stage_id", stage.id()}, {"name", "course a"}}));
+	const auto courseB = e.create(Record(Table::Course, {{"name", "course b"}}));
+
+	const QVector<QPair<TableFilter, QVector<Id>>> cases = {
+		{TableFilter("id", TableFilter::In, QVariantList({profiles.at(7).id(), profiles.at(2).id(), Id(4711)})),
+		 {profiles.at(2).id(), profiles.at(7).id()}},
+		{TableFilter("id", TableFilter::In, QVariantList()), {}},
+		{TableFilter("name", TableFilter::In, QVariantList({"ab profile 1", "ac profile 9"})),
+		 {profiles.at(1).id(), profiles.at(9).id()}},
+		{TableFilter("id", TableFilter::Between, QVariantList({profiles.at(3).id(), profiles.at(5).id()})),
+		 {profiles.at(3).id(), profiles.at(4).id(), profiles.at(5).id()}},
+		{TableFilter("name", TableFilter::StartsWith, "ac"), ids(profiles.mid(5))},
+		{TableFilter("name", TableFilter::StartsWith, "ab profile 3"), {profiles.at(3).id()}},
+		{TableFilter("name", TableFilter::StartsWith, "AB"), {}},
+	};
+	for (const auto &testCase : cases) {
+		const TableQuery query(Table::Profile, testCase.first);
+		const QVector<Record> found = e.find(TableQuery::fromJson(query.toJson()));
+		REQUIRE(ids(found) == testCase.second);
+
+		const ChangeQuery changeQuery(query);
+		for (const Record &profile : profiles) {
+			REQUIRE(changeQuery.matches(Change(Change::Update), profile) == testCase.second.contains(profile.id()));
+		}
+	}
+
+	// resident table
+	REQUIRE(ids(e.find(TableQuery(Table::Course, TableFilter("stage_id", TableFilter::IsNull, true)))) == QVector<Id>({courseB.id()}));
+	REQUIRE(ids(e.find(TableQuery(Table::Course, TableFilter("stage_id", TableFilter::IsNull, false)))) == QVector<Id>({courseA.id()}));
+	REQUIRE(ids(e.find(TableQuery(Table::Course, TableFilter("id", TableFilter::In, QVariantList({courseB.id(), courseA.id()})))))
+			== QVector<Id>({courseA.id(), courseB.id()}));
+
+	REQUIRE_THROWS_AS(e.find(TableQuery(Table::Profile, TableFilter("id", TableFilter::Between, QVariantList({1})))),
+					  ValidationException);
+}
+
+TEST_CASE("filter trees") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	const auto compA = e.create(Record(Table::Competition, {{"name", "comp a"}, {"sport", "Orienteering"}}));
+	const auto compB = e.create(Record(Table::Competition, {{"name", "comp b"}, {"sport", "Orienteering"}}));
+	QVector<Record> stages;
+	for (int i = 0; i < 12; ++i) {
+		stages.append(e.create(Record(Table::Stage, {
+										  {"name", QStringLiteral("stage %1").arg(i)},
+										  {"date", QDate(2019, 5, 1).addDays(i)},
+										  {"discipline", i % 3 ? "Middle" : "Sprint"},
+										  {"in_totals", true},
+										  {"type", "Relay"},
+										  {"competition_id", i % 2 ? compA.id() : compB.id()}
+									  })));
+	}
+	const auto courseA = e.create(Record(Table::Course, {{"stage_id", stages.at(0).id()}, {"name", "course a"}}));
+	const auto courseB = e.create(Record(Table::Course, {{"stage_id", stages.at(1).id()}, {"name", "course b"}}));
+	const auto courseC = e.create(Record(Table::Course, {{"name", "course c"}}));
+
+	const TableFilter sprint("discipline", "Sprint");
+	const TableFilter inA("competition_id", compA.id());
+	const QVector<QPair<TableFilter, QVector<Id>>> cases = {
+		{TableFilter::anyOf({TableFilter("name", "stage 1"), TableFilter("name", "stage 4")}),
+		 {stages.at(1).id(), stages.at(4).id()}},
+		{TableFilter::allOf({sprint, inA}), {stages.at(3).id(), stages.at(9).id()}},
+		{TableFilter::anyOf({TableFilter::allOf({sprint, inA}), TableFilter("id", stages.at(2).id())}),
+		 {stages.at(2).id(), stages.at(3).id(), stages.at(9).id()}},
+		{TableFilter::negated(TableFilter::anyOf({inA, TableFilter("discipline", "Middle")})),
+		 {stages.at(0).id(), stages.at(6).id()}},
+		{TableFilter::anyOf({}), {}},
+		{TableFilter::allOf({}), ids(stages)},
+	};
+	for (const auto &testCase : cases) {
+		const TableQuery query(Table::Stage, testCase.first);
+		const QVector<Record> resident = e.find(TableQuery::fromJson(query.toJson()));
+		e.setResident(Table::Stage, false);
+		const QVector<Record> database = e.find(query);
+		e.setResident(Table::Stage, true);
+		REQUIRE(ids(resident) == testCase.second);
+		REQUIRE(ids(database) == testCase.second);
+
+		const QueryPlan plan(query);
+		for (const Record &stage : stages) {
+			REQUIRE(testCase.first.matches(stage) == testCase.second.contains(stage.id()));
+			REQUIRE(plan.matches(stage) == testCase.second.contains(stage.id()));
+		}
+	}
+
+	// joins are kept for records without a referenced record so that the other alternatives still apply
+	const TableFilter courses = TableFilter::anyOf({TableFilter("stage_id>competition_id", compB.id()), TableFilter("name", "course c")});
+	REQUIRE(ids(e.find(TableQuery(Table::Course, courses))) == QVector<Id>({courseA.id(), courseC.id()}));
+	REQUIRE(courses.matches(courseB)); // the competition of the stage is not known when matching
+	REQUIRE(courses.matches(courseC));
+
+	// comparisons with NULL are neither true nor false
+	REQUIRE_FALSE(TableFilter::negated(TableFilter("stage_id", stages.at(0).id())).matches(courseC));
+	REQUIRE(ids(e.find(TableQuery(Table::Course, TableFilter::negated(TableFilter("stage_id", stages.at(0).id())))))
+			== QVector<Id>({courseB.id()}));
+}
+
+TEST_CASE("sorting and pagination") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	for (int i = 0; i < 25; ++i) {
+		Record record = createRecord();
+		record.setValue("name", QStringLiteral("profile %1").arg(i % 4));
+		record.setValue("type", i % 2 ? "odd" : "even");
+		REQUIRE_NOTHROW(e.create(record));
+	}
+
+	TableQuery query(Table::Profile);
+	query.setSort({TableSort("name", true), TableSort("type")});
+	const QVector<Record> all = e.find(query);
+	REQUIRE(all.size() == 25);
+	REQUIRE(all.first().value("name") == "profile 3");
+	REQUIRE(all.last().value("name") == "profile 0");
+	for (int i = 1; i < all.size(); ++i) {
+		REQUIRE_FALSE(query.lessThan(all.at(i), all.at(i - 1)));
+	}
+
+	// walking the pages yields every record once and in order
+	query.setLimit(7);
+	QVector<Record> paged;
+	QVector<Record> page = e.find(query);
+	while (!page.isEmpty()) {
+		REQUIRE(page.size() <= 7);
+		paged += page;
+		query.setAfter(page.last());
+
+		// subscriptions for the next page only see records after the cursor
+		const QueryPlan plan(query);
+		for (int i = 0; i < all.size(); ++i) {
+			REQUIRE(plan.matches(all.at(i)) == (i >= paged.size()));
+		}
+		page = e.find(TableQuery::fromJson(query.toJson()));
+	}
+	REQUIRE(ids(paged) == ids(all));
+
+	query.setAfter(QVector<QVariant>() << "profile 1");
+	REQUIRE_THROWS_AS(e.find(query), ValidationException);
+	query.setAfter(QVector<QVariant>());
+	query.setSort({TableSort("nonexistent")});
+	REQUIRE_THROWS_AS(e.find(query), ValidationException);
+}
+
+TEST_CASE("pagination across NULL values") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	const QVector<QVariant> names = {QVariant(), "b", "a", QVariant(), "a", QVariant()};
+	QVector<Id> created;
+	for (const QVariant &name : names) {
+		Record record(Table::Class, {{"stage_id", 1}});
+		if (!name.isNull()) {
+			record.setValue("name", name);
+		}
+		created.append(e.create(record).id());
+	}
+	// NULL comes first in ascending and last in descending order
+	const QVector<Id> ascending = {created.at(0), created.at(3), created.at(5), created.at(2), created.at(4), created.at(1)};
+	const QVector<Id> descending = {created.at(1), created.at(2), created.at(4), created.at(0), created.at(3), created.at(5)};
+
+	for (const bool resident : {true, false}) {
+		e.setResident(Table::Class, resident);
+		for (const bool descend : {false, true}) {
+			TableQuery query(Table::Class);
+			query.setSort({TableSort("name", descend)});
+			query.setLimit(2);
+
+			QVector<Record> paged;
+			QVector<Record> page = e.find(query);
+			while (!page.isEmpty()) {
+				paged += page;
+				query.setAfter(page.last());
+				for (const Record &record : paged) {
+					REQUIRE_FALSE(QueryPlan(query).matches(record));
+				}
+				page = e.find(TableQuery::fromJson(query.toJson()));
+			}
+			REQUIRE(ids(paged) == (descend ? descending : ascending));
+		}
+	}
+}
+
+TEST_CASE("aggregates") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	for (int i = 0; i < 10; ++i) {
+		REQUIRE_NOTHROW(e.create(Record(Table::CourseControl, {
+											{"control_id", i + 1},
+											{"course_id", i % 3 + 1},
+											{"order", i},
+											{"distance_from_previous", 100.0 * i}
+										})));
+	}
+	const Record deleted = e.create(Record(Table::CourseControl, {
+											   {"control_id", 11},
+											   {"course_id", 1},
+											   {"order", 100},
+											   {"distance_from_previous", 1000.0}
+										   }));
+	REQUIRE_NOTHROW(e.delete_(Table::CourseControl, deleted.id()));
+
+	// "order" is a keyword that only works as a column name when escaped
+	TableQuery ordered(Table::CourseControl, TableFilter("order", TableFilter::Less, 3));
+	ordered.setSort({TableSort("order", true)});
+	const QVector<Record> orderedControls = e.find(ordered);
+	REQUIRE(orderedControls.size() == 3);
+	REQUIRE(orderedControls.first().value("order") == 2);
+
+	const QVector<Aggregate> aggregates = {
+		Aggregate(Aggregate::Count),
+		Aggregate(Aggregate::Sum, "distance_from_previous"),
+		Aggregate(Aggregate::Min, "order"),
+		Aggregate(Aggregate::Max, "order")
+	};
+
+	SECTION("ungrouped") {
+		const AggregateResult result = e.aggregate(AggregateQuery(TableQuery(Table::CourseControl), aggregates));
+		REQUIRE(result.revision() == e.latestRevision());
+		REQUIRE(result.groups().size() == 1);
+		REQUIRE(result.groups().first().key().isEmpty());
+		REQUIRE(result.groups().first().values().at(0).toInt() == 10);
+		REQUIRE(result.groups().first().values().at(1).toDouble() == Approx(4500.0));
+		REQUIRE(result.groups().first().values().at(2).toInt() == 0);
+		REQUIRE(result.groups().first().values().at(3).toInt() == 9);
+
+		// counting nothing still yields a group
+		const AggregateResult empty = e.aggregate(AggregateQuery(TableQuery(Table::CourseControl, TableFilter("course_id", 42)),
+																 aggregates));
+		REQUIRE(empty.groups().size() == 1);
+		REQUIRE(empty.groups().first().values().at(0).toInt() == 0);
+		REQUIRE(empty.groups().first().values().at(2).isNull());
+	}
+
+	SECTION("grouped") {
+		const AggregateQuery query(TableQuery(Table::CourseControl, TableFilter("control_id", TableFilter::LessEqual, 9)),
+								   aggregates, {"course_id"});
+		const AggregateResult result = e.aggregate(query);
+		REQUIRE(result.groups().size() == 3);
+		REQUIRE(result.groups().at(0).key().first().toInt() == 1);
+		REQUIRE(result.groups().at(0).values().at(0).toInt() == 3); // orders 0, 3 and 6, 9 is filtered
+		REQUIRE(result.groups().at(0).values().at(3).toInt() == 6);
+		REQUIRE(result.groups().at(1).key().first().toInt() == 2);
+		REQUIRE(result.groups().at(1).values().at(0).toInt() == 3);
+		REQUIRE(result.groups().at(1).values().at(1).toDouble() == Approx(1200.0));
+		REQUIRE(result.groups().at(2).values().at(2).toInt() == 2);
+
+		const AggregateResult roundTrip = AggregateResult::fromJson(result.toJson());
+		REQUIRE(roundTrip.query() == query);
+		REQUIRE(roundTrip.groups().size() == 3);
+		REQUIRE(roundTrip.groups().at(1).values().at(0).toInt() == 3);
+	}
+
+	SECTION("validation") {
+		const auto aggregate = [&e](const AggregateQuery &query) { return e.aggregate(query); };
+		REQUIRE_THROWS_AS(aggregate(AggregateQuery(TableQuery(Table::CourseControl), {})), ValidationException);
+		REQUIRE_THROWS_AS(aggregate(AggregateQuery(TableQuery(Table::CourseControl), aggregates, {"nonexistent"})), ValidationException);
+		REQUIRE_THROWS_AS(aggregate(AggregateQuery(TableQuery(Table::CourseControl), {Aggregate(Aggregate::Max)})), ValidationException);
+		REQUIRE_THROWS_AS(aggregate(AggregateQuery(TableQuery(Table::Profile), {Aggregate(Aggregate::Sum, "name")})), ValidationException);
+		TableQuery sorted(Table::CourseControl);
+		sorted.setSort({TableSort("order")});
+		REQUIRE_THROWS_AS(aggregate(AggregateQuery(sorted, aggregates)), ValidationException);
+	}
+}
+
+TEST_CASE("checkpoints") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	Record in = createRecord();
+	REQUIRE_NOTHROW(e.create(in)); // 1
+	REQUIRE_NOTHROW(e.create(in)); // 2
+	Record update(in.table());
+	update.setId(1);
+	update.setValue("name", "bar");
+	REQUIRE_NOTHROW(e.update(update)); // 3
+	REQUIRE_NOTHROW(e.delete_(Table::Profile, 2)); // 4
+	REQUIRE_NOTHROW(e.create(in)); // 5
+
+	// the newest change is always kept
+	REQUIRE(e.checkpoint(QDateTime::currentMSecsSinceEpoch() + 1000) == 4);
+	REQUIRE(e.checkpointRevision() == 4);
+
+	QSqlQuery changesLeft = db.exec("SELECT COUNT(*) FROM change");
+	REQUIRE(changesLeft.next());
+	REQUIRE(changesLeft.value(0).toInt() == 1);
+	QSqlQuery profilesLeft = db.exec("SELECT COUNT(*) FROM profile");
+	REQUIRE(profilesLeft.next());
+	REQUIRE(profilesLeft.value(0).toInt() == 2);
+
+	REQUIRE(e.read(Table::Profile, 1).latestRevision() == 4);
+	REQUIRE(e.read(Table::Profile, 3).latestRevision() == 5);
+
+	auto behind = e.changes(ChangeQuery(TableQuery(Table::Profile), 2));
+	REQUIRE(behind.isResyncRequired());
+	REQUIRE(behind.changes().isEmpty());
+	REQUIRE(behind.lastRevision() == 5);
+
+	auto current = e.changes(ChangeQuery(TableQuery(Table::Profile), 4));
+	REQUIRE_FALSE(current.isResyncRequired());
+	REQUIRE(current.changes().size() == 1);
+
+	auto everything = e.changes(ChangeQuery(TableQuery(Table::Profile)));
+	REQUIRE_FALSE(everything.isResyncRequired());
+	REQUIRE(everything.changes().size() == 1);
+
+	DatabaseEngine restarted(db);
+	REQUIRE(restarted.checkpointRevision() == 4);
+	REQUIRE(restarted.changes(ChangeQuery(TableQuery(Table::Profile), 2)).isResyncRequired());
+}
+
+TEST_CASE("table revisions") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	REQUIRE(e.latestRevision() == 0);
+	REQUIRE_NOTHROW(e.create(createRecord()));
+	REQUIRE_NOTHROW(e.create(Record(Table::Competition, {{"name", "comp"}, {"sport", "Orienteering"}})));
+
+	REQUIRE(e.latestRevision() == 2);
+	REQUIRE(e.tableRevision(Table::Profile) == 1);
+	REQUIRE(e.tableRevision(Table::Competition) == 2);
+	REQUIRE(e.tableRevision(Table::Stage) == 0);
+
+	auto unchanged = e.changes(ChangeQuery(TableQuery(Table::Profile), 1));
+	REQUIRE(unchanged.changes().isEmpty());
+	REQUIRE(unchanged.lastRevision() == 2);
+
+	// replies that are cut short only report the revisions they contain
+	for (int i = 0; i < 150; ++i) {
+		REQUIRE_NOTHROW(e.create(createRecord()));
+	}
+	auto partial = e.changes(ChangeQuery(TableQuery(Table::Profile), 2));
+	REQUIRE(partial.changes().size() == 100);
+	REQUIRE(partial.lastRevision() == partial.changes().last().revision());
+	auto rest = e.changes(ChangeQuery(TableQuery(Table::Profile), partial.lastRevision()));
+	REQUIRE(rest.changes().size() == 50);
+	REQUIRE(rest.lastRevision() == e.latestRevision());
+	ChangeQuery compact(TableQuery(Table::Profile), 2);
+	compact.setCompact(true);
+	REQUIRE(e.changes(compact).changes().size() == 150);
+
+	DatabaseEngine restarted(db);
+	REQUIRE(restarted.latestRevision() == 2);
+	REQUIRE(restarted.tableRevisions() == e.tableRevisions());
+}
+
+TEST_CASE("conditional requests") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	const Record comp = e.create(Record(Table::Competition, {{"name", "comp"}, {"sport", "Orienteering"}}));
+	const Record stage = e.create(Record(Table::Stage, {
+											 {"name", "stage"},
+											 {"date", QDate::currentDate()},
+											 {"discipline", "Middle"},
+											 {"in_totals", true},
+											 {"type", "Relay"},
+											 {"competition_id", comp.id()}
+										 }));
+	const Record course = e.create(Record(Table::Course, {{"stage_id", stage.id()}, {"name", "course"}}));
+	const Record profile = e.create(createRecord());
+	const Revision known = e.latestRevision();
+
+	const TableQuery courses(Table::Course, TableFilter("stage_id>competition_id", comp.id()));
+	REQUIRE(e.queryRevision(courses) == 3); // the course, the stage is older and the competition is not joined
+
+	ConditionalResult result = e.findIfModified(courses, known);
+	REQUIRE_FALSE(result.isModified());
+	REQUIRE(result.revision() == known);
+	REQUIRE(e.findIfModified(courses, 0).records().size() == 1);
+
+	// changes to other tables do not matter, but those of joined ones do
+	REQUIRE_NOTHROW(e.create(createRecord()));
+	REQUIRE_FALSE(e.findIfModified(courses, known).isModified());
+	Record stageUpdate(Table::Stage, {{"name", "renamed"}});
+	stageUpdate.setId(stage.id());
+	REQUIRE_NOTHROW(e.update(stageUpdate));
+	REQUIRE(e.queryRevision(courses) == e.latestRevision());
+	result = ConditionalResult::fromJson(e.findIfModified(courses, known).toJson());
+	REQUIRE(result.isModified());
+	REQUIRE(ids(result.records()) == QVector<Id>({course.id()}));
+	REQUIRE(result.revision() == e.latestRevision());
+
+	// records are compared by their own revision once their table has changed
+	REQUIRE_FALSE(e.readIfModified(Table::Profile, profile.id(), known).isModified());
+	REQUIRE_FALSE(e.readIfModified(Table::Stage, stage.id(), e.latestRevision()).isModified());
+	result = e.readIfModified(Table::Stage, stage.id(), known);
+	REQUIRE(result.isModified());
+	REQUIRE(result.records().first().value("name") == "renamed");
+	REQUIRE_NOTHROW(e.delete_(Table::Profile, profile.id()));
+	REQUIRE_THROWS(e.readIfModified(Table::Profile, profile.id(), known));
+}
+
+TEST_CASE("optimistic concurrency") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	const Record profile = e.create(createRecord());
+	const Record other = e.create(createRecord());
+	const Revision created = e.read(Table::Profile, profile.id()).latestRevision();
+
+	Record update(Table::Profile, {{"name", "first"}});
+	update.setId(profile.id());
+	const Revision updated = e.update(update, created);
+	REQUIRE(e.read(Table::Profile, profile.id()).latestRevision() == updated);
+
+	// a second writer that still has the old revision does not overwrite the first one
+	update.setValue("name", "second");
+	REQUIRE_THROWS_AS(e.update(update, created), ConflictException);
+	REQUIRE(e.read(Table::Profile, profile.id()).value("name") == "first");
+	REQUIRE(e.latestRevision() == updated);
+	REQUIRE_THROWS_AS(e.delete_(Table::Profile, profile.id(), created), ConflictException);
+	REQUIRE_NOTHROW(e.read(Table::Profile, profile.id()));
+
+	// changes to other records do not conflict
+	Record otherUpdate(Table::Profile, {{"name", "other"}});
+	otherUpdate.setId(other.id());
+	REQUIRE_NOTHROW(e.update(otherUpdate, e.read(Table::Profile, other.id()).latestRevision()));
+	Revision current = 0;
+	REQUIRE_NOTHROW(current = e.update(update, updated));
+	REQUIRE_NOTHROW(e.delete_(Table::Profile, profile.id(), current));
+	REQUIRE_THROWS(e.read(Table::Profile, profile.id()));
+	REQUIRE_THROWS_AS(e.delete_(Table::Profile, profile.id(), current), ConflictException);
+	REQUIRE_THROWS_AS(e.delete_(Table::Profile, 9999, current), JD::Util::Database::DoesntExistException);
+
+	// records that have not changed since the checkpoint are of the checkpoint revision
+	const Revision checkpoint = e.checkpoint(QDateTime::currentMSecsSinceEpoch() + 1000);
+	REQUIRE(e.read(Table::Profile, other.id()).latestRevision() == checkpoint);
+	REQUIRE_NOTHROW(e.delete_(Table::Profile, other.id(), checkpoint));
+}
+
+TEST_CASE("record cache") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	const auto comp = e.create(Record(Table::Competition, {{"name", "comp"}, {"sport", "Orienteering"}}));
+	const auto stage = e.create(Record(Table::Stage, {
+										   {"name", "stage 1"},
+										   {"date", QDate::currentDate()},
+										   {"discipline", "Middle"},
+										   {"in_totals", true},
+										   {"type", "Relay"},
+										   {"competition_id", comp.id()}
+									   }));
+
+	const quint64 hits = e.cacheHits();
+	const quint64 misses = e.cacheMisses();
+	REQUIRE(e.read(Table::Stage, stage.id()) == stage);
+	REQUIRE(e.read(Table::Stage, stage.id()) == stage);
+	REQUIRE(e.cacheHits() == hits + 2);
+	REQUIRE(e.cacheMisses() == misses);
+
+	// not a cached table
+	REQUIRE_NOTHROW(e.read(Table::Competition, comp.id()));
+	REQUIRE(e.cacheHits() == hits + 2);
+	REQUIRE(e.cacheMisses() == misses);
+
+	Record update(Table::Stage);
+	update.setId(stage.id());
+	update.setValue("name", "stage 2");
+	const Revision revision = e.update(update);
+	const Record updated = e.read(Table::Stage, stage.id());
+	REQUIRE(e.cacheHits() == hits + 3);
+	REQUIRE(updated.value("name") == "stage 2");
+	REQUIRE(updated.latestRevision() == revision);
+
+	REQUIRE_NOTHROW(e.delete_(Table::Stage, stage.id()));
+	REQUIRE_THROWS_AS(e.read(Table::Stage, stage.id()), JD::Util::Database::DoesntExistException);
+
+	const quint64 missesAfterDelete = e.cacheMisses();
+	e.setCacheLimit(Table::Stage, 0);
+	REQUIRE_THROWS_AS(e.read(Table::Stage, stage.id()), JD::Util::Database::DoesntExistException);
+	REQUIRE(e.cacheMisses() == missesAfterDelete);
+}
+
+TEST_CASE("interned strings") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	REQUIRE_NOTHROW(e.create(createRecord()));
+	REQUIRE_NOTHROW(e.create(createRecord()));
+
+	const QVector<Record> records = e.find(TableQuery(Table::Profile));
+	REQUIRE(records.size() == 2);
+	// equal values of repetitive fields share their storage, other values are not interned
+	REQUIRE(records.at(0).value("type").toString().constData() == records.at(1).value("type").toString().constData());
+	REQUIRE(records.at(0).value("name").toString().constData() != records.at(1).value("name").toString().constData());
+}
+
+TEST_CASE("record json round trip") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	const auto comp = e.create(Record(Table::Competition, {{"name", "comp"}, {"sport", "Orienteering"}}));
+	const auto stage = e.create(Record(Table::Stage, {
+										   {"name", "stage 1"},
+										   {"date", QDate(2019, 5, 1)},
+										   {"discipline", "Middle"},
+										   {"in_totals", true},
+										   {"type", "Relay"},
+										   {"competition_id", comp.id()}
+									   }));
+
+	const Record decoded = Record::fromJson(stage.toJson().toObject());
+	REQUIRE(decoded.id() == stage.id());
+	REQUIRE(decoded.latestRevision() == stage.latestRevision());
+	REQUIRE(decoded.fields() == stage.fields());
+	REQUIRE(decoded.value("name") == "stage 1");
+	REQUIRE(decoded.value("date") == QDate(2019, 5, 1));
+	REQUIRE(decoded.value("in_totals") == true);
+	REQUIRE(decoded.value("competition_id").value<Id>() == comp.id());
+
+	QJsonObject unknown = stage.toJson().toObject();
+	QJsonObject values = unknown.value("values").toObject();
+	values.insert("nonexistent", 1);
+	unknown.insert("values", values);
+	REQUIRE_THROWS_AS(Record::fromJson(unknown), UnknownFieldException);
+}
+
+TEST_CASE("resident tables") {
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	REQUIRE(e.isResident(Table::Stage));
+
+	const auto compA = e.create(Record(Table::Competition, {{"name", "comp a"}, {"sport", "Orienteering"}}));
+	const auto compB = e.create(Record(Table::Competition, {{"name", "comp b"}, {"sport", "Orienteering"}}));
+	QVector<Record> stages;
+	for (int i = 0; i < 150; ++i) {
+		stages.append(e.create(Record(Table::Stage, {
+										  {"name", QStringLiteral("stage %1").arg(i % 7)},
+										  {"date", QDate(2019, 5, 1).addDays(i % 10)},
+										  {"discipline", i % 2 ? "Middle" : "Sprint"},
+										  {"in_totals", i % 3 == 0},
+										  {"type", "Relay"},
+										  {"competition_id", i % 4 ? compA.id() : compB.id()}
+									  })));
+	}
+	REQUIRE_NOTHROW(e.delete_(Table::Stage, stages.at(10).id()));
+	Record update(Table::Stage);
+	update.setId(stages.at(20).id());
+	update.setValue("name", "renamed");
+	REQUIRE_NOTHROW(e.update(update));
+
+	QVector<TableQuery> queries = {
+		TableQuery(Table::Stage),
+		TableQuery(Table::Stage, TableFilter("id", stages.at(20).id())),
+		TableQuery(Table::Stage, TableFilter("id", stages.at(10).id())),
+		TableQuery(Table::Stage, TableFilter("id", TableFilter::Greater, stages.at(100).id())),
+		TableQuery(Table::Stage, TableFilter("name", "stage 3")),
+		TableQuery(Table::Stage, TableFilter("name", "renamed")),
+		TableQuery(Table::Stage, TableFilter("name", "nonexistent")),
+		TableQuery(Table::Stage, TableFilter("name", TableFilter::NotEqual, "stage 3")),
+		TableQuery(Table::Stage, TableFilter("name", TableFilter::Greater, "stage 4")),
+		TableQuery(Table::Stage, TableFilter("in_totals", true)),
+		TableQuery(Table::Stage, TableFilter("date", TableFilter::LessEqual, QDate(2019, 5, 4))),
+		TableQuery(Table::Stage, {TableFilter("competition_id", compA.id()), TableFilter("discipline", "Sprint"),
+								  TableFilter("in_totals", false)}),
+	};
+
+	TableQuery sorted(Table::Stage, TableFilter("discipline", "Sprint"));
+	sorted.setSort({TableSort("name", true), TableSort("date")});
+	sorted.setLimit(20);
+	TableQuery nextPage = sorted;
+	nextPage.setAfter(e.find(sorted).last());
+	queries << sorted << nextPage;
+
+	for (const TableQuery &query : queries) {
+		const QVector<Record> resident = e.find(query);
+		e.setResident(Table::Stage, false);
+		const QVector<Record> database = e.find(query);
+		e.setResident(Table::Stage, true);
+
+		REQUIRE(ids(resident) == ids(database));
+		for (int i = 0; i < resident.size(); ++i) {
+			REQUIRE(resident.at(i) == database.at(i));
+			REQUIRE(resident.at(i).value("in_totals").type() == database.at(i).value("in_totals").type());
+			REQUIRE(resident.at(i).value("date").type() == database.at(i).value("date").type());
+			REQUIRE(resident.at(i).toJson() == database.at(i).toJson());
+		}
+	}
+
+	// reads are answered from the store as well, except for deleted records
+	e.setCacheLimit(Table::Stage, 0);
+	REQUIRE(e.read(Table::Stage, stages.at(20).id()).value("name") == "renamed");
+	REQUIRE(e.read(Table::Stage, stages.at(20).id(), false, {"name"}).fields() == QVector<QString>({"name"}));
+	REQUIRE_THROWS_AS(e.read(Table::Stage, stages.at(10).id()), JD::Util::Database::DoesntExistException);
+	REQUIRE_NOTHROW(e.read(Table::Stage, stages.at(10).id(), true));
+
+	// without a binary collation in the database, filters on strings are left to it
+	ColumnStore store(Table::Stage);
+	store.upsert(e.read(Table::Stage, stages.at(20).id()));
+	const TableQuery byName(Table::Stage, TableFilter("name", "renamed"));
+	REQUIRE(static_cast<bool>(store.find(byName)));
+	store.setBinaryStrings(false);
+	REQUIRE_FALSE(static_cast<bool>(store.find(byName)));
+	REQUIRE(static_cast<bool>(store.find(TableQuery(Table::Stage, TableFilter("in_totals", false)))));
+
+	// JSON fields are held as their text
+	const Record profile = e.create(createRecord());
+	REQUIRE_FALSE(e.isResident(Table::Profile));
+	e.setAllResident();
+	REQUIRE(e.isResident(Table::Profile));
+	REQUIRE(e.isResident(Table::CourseControl));
+	REQUIRE(e.find(TableQuery(Table::Profile)) == QVector<Record>({profile}));
+	const Record other = e.create(createRecord());
+	REQUIRE(e.isResident(Table::Profile));
+	REQUIRE(e.find(TableQuery(Table::Profile)).size() == 2);
+	REQUIRE(e.read(Table::Profile, other.id()).value("value") == "{}");
+}
+
+TEST_CASE("journal replay") {
+	QTemporaryDir dir;
+	REQUIRE(dir.isValid());
+	const QString path = dir.filePath("sportsed.journal");
+
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	Record kept;
+	{
+		Journal journal(path);
+		REQUIRE(journal.replay(e) == 0);
+		e.setJournal(&journal);
+
+		kept = e.create(createRecord());
+		const Record deleted = e.create(createRecord());
+		Record update(Table::Profile);
+		update.setId(kept.id());
+		update.setValue("name", "bar");
+		REQUIRE_NOTHROW(e.update(update));
+		REQUIRE_NOTHROW(e.delete_(Table::Profile, deleted.id()));
+		e.setJournal(nullptr);
+	}
+
+	QSqlDatabase replayDb = database();
+	DatabaseEngine replayed(replayDb);
+	Journal journal(path);
+	REQUIRE(journal.replay(replayed) == 4);
+	REQUIRE(replayed.latestRevision() == e.latestRevision());
+	REQUIRE(replayed.tableRevisions() == e.tableRevisions());
+
+	const QVector<Record> records = replayed.find(TableQuery(Table::Profile));
+	REQUIRE(records.size() == 1);
+	REQUIRE(records.first().id() == kept.id());
+	REQUIRE(records.first().value("name") == "bar");
+	REQUIRE(records.first().latestRevision() == e.latestRevision() - 1);
+
+	const auto changes = replayed.changes(ChangeQuery(TableQuery(Table::Profile), 0));
+	REQUIRE(changes.changes().size() == 4);
+	REQUIRE(changes.changes().last().type() == Change::Delete);
+
+	// a crash while writing leaves an incomplete entry at the end
+	const qint64 size = QFileInfo(path).size();
+	{
+		QFile file(path);
+		REQUIRE(file.open(QFile::Append));
+		file.write("{\"revision\":5,\"ta");
+	}
+	QSqlDatabase tornDb = database();
+	DatabaseEngine torn(tornDb);
+	Journal tornJournal(path);
+	REQUIRE(tornJournal.replay(torn) == 4);
+	REQUIRE(QFileInfo(path).size() == size);
+
+	// or a complete entry without its newline, which the next entry must not continue
+	{
+		QFile file(path);
+		REQUIRE(file.resize(size - 1));
+	}
+	QSqlDatabase unterminatedDb = database();
+	DatabaseEngine unterminated(unterminatedDb);
+	{
+		Journal unterminatedJournal(path);
+		REQUIRE(unterminatedJournal.replay(unterminated) == 4);
+		REQUIRE(QFileInfo(path).size() == size);
+		unterminated.setJournal(&unterminatedJournal);
+		REQUIRE_NOTHROW(unterminated.create(createRecord()));
+		unterminated.setJournal(nullptr);
+	}
+	QSqlDatabase appendedDb = database();
+	DatabaseEngine appended(appendedDb);
+	Journal appendedJournal(path);
+	REQUIRE(appendedJournal.replay(appended) == 5);
+}
+
+TEST_CASE("journal compaction") {
+	QTemporaryDir dir;
+	REQUIRE(dir.isValid());
+	const QString path = dir.filePath("sportsed.journal");
+
+	QSqlDatabase db = database();
+	DatabaseEngine e(db);
+	Journal journal(path);
+	REQUIRE(journal.replay(e) == 0);
+	e.setJournal(&journal);
+
+	const Record kept = e.create(createRecord()); // 1
+	const Record deleted = e.create(createRecord()); // 2
+	Record update(Table::Profile);
+	update.setId(kept.id());
+	for (const QString &name : {"a", "b", "c"}) {
+		update.setValue("name", name);
+		REQUIRE_NOTHROW(e.update(update)); // 3, 4, 5
+	}
+	REQUIRE_NOTHROW(e.delete_(Table::Profile, deleted.id())); // 6
+	const Record recent = e.create(createRecord()); // 7
+	const qint64 uncompacted = QFileInfo(path).size();
+
+	// the newest change is kept, everything before it is replaced by the records
+	REQUIRE(e.checkpoint(QDateTime::currentMSecsSinceEpoch() + 1000) == 6);
+	REQUIRE(QFileInfo(path).size() < uncompacted);
+
+	// appending continues in the rewritten journal
+	update.setValue("name", "d");
+	REQUIRE_NOTHROW(e.update(update)); // 8
+	e.setJournal(nullptr);
+	journal.sync();
+
+	QSqlDatabase replayDb = database();
+	DatabaseEngine replayed(replayDb);
+	Journal replayJournal(path);
+	// the checkpoint, two records and two changes
+	REQUIRE(replayJournal.replay(replayed) == 5);
+	REQUIRE(replayed.checkpointRevision() == 6);
+	REQUIRE(replayed.latestRevision() == e.latestRevision());
+	REQUIRE(replayed.tableRevisions() == e.tableRevisions());
+
+	const QVector<Record> records = replayed.find(TableQuery(Table::Profile));
+	REQUIRE(ids(records) == QVector<Id>({kept.id(), recent.id()}));
+	REQUIRE(records.first().value("name") == "d");
+	REQUIRE(records.first().latestRevision() == 8);
+	REQUIRE(records.last().latestRevision() == 7);
+	REQUIRE_THROWS(replayed.read(Table::Profile, deleted.id(), true));
+
+	REQUIRE(replayed.changes(ChangeQuery(TableQuery(Table::Profile), 2)).isResyncRequired());
+	const auto changes = replayed.changes(ChangeQuery(TableQuery(Table::Profile), 6));
+	REQUIRE(changes.changes().size() == 2);
+	REQUIRE(changes.changes().last().record().value("name") == "d");
 }
 
 TEST_CASE("completing") {
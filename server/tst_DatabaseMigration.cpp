@@ -41,7 +41,7 @@ TEST_CASE("database version") {
 	QSqlDatabase db = inMemoryDb();
 	REQUIRE(DatabaseMigration::currentVersion(db) == -1);
 	REQUIRE_NOTHROW(DatabaseMigration::create(db));
-	REQUIRE(DatabaseMigration::latestVersion() == 1);
+	REQUIRE(DatabaseMigration::latestVersion() == 2);
 	REQUIRE(DatabaseMigration::currentVersion(db) == DatabaseMigration::latestVersion());
 }
 